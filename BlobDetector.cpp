@@ -0,0 +1,143 @@
+/*
+ * File:   BlobDetector.cpp
+ * Author: Jan Dufek
+ */
+
+#include "BlobDetector.hpp"
+
+/**
+ * Threshold and morphology over bands.
+ */
+class FilterBandsInvoker : public ParallelLoopBody {
+public:
+
+    FilterBandsInvoker(BlobDetector& d, const Mat& b, int r) : detector(d), back_projection(b), band_rows(r) {
+    }
+
+    virtual void operator()(const Range& range) const {
+        detector.filter_bands(back_projection, range, band_rows);
+    }
+
+private:
+
+    BlobDetector& detector;
+    const Mat& back_projection;
+    int band_rows;
+
+};
+
+/**
+ * Blobs with higher score go first.
+ *
+ * @param a
+ * @param b
+ * @return
+ */
+static bool compare_blobs(const Blob& a, const Blob& b) {
+    return a.score > b.score;
+}
+
+BlobDetector::BlobDetector(Settings& s) {
+    settings = &s;
+}
+
+BlobDetector::~BlobDetector() {
+}
+
+/**
+ * Find blobs in the back projection.
+ *
+ * @param back_projection
+ * @return blobs within the blob area limits, best first
+ */
+vector<Blob> BlobDetector::detect(const Mat& back_projection) {
+
+    mask.create(back_projection.size(), CV_8UC1);
+
+    // Bands for the thread pool, each at least a few halos tall
+    int halo = settings->erode_size + settings->dilate_size;
+    int threads = max(getNumThreads(), 1);
+    int band_rows = max((back_projection.rows + 2 * threads - 1) / (2 * threads), 4 * halo);
+    int band_count = (back_projection.rows + band_rows - 1) / band_rows;
+
+    parallel_for_(Range(0, band_count), FilterBandsInvoker(*this, back_projection, band_rows), band_count);
+
+    int label_count = connectedComponentsWithStats(mask, labels, statistics, centroids, 8, CV_32S);
+
+    // Back projection sum of each blob
+    vector<double> sums(label_count, 0);
+
+    for (int y = 0; y < labels.rows; y++) {
+
+        const int * label = labels.ptr<int>(y);
+        const uchar * pixel = back_projection.ptr<uchar>(y);
+
+        for (int x = 0; x < labels.cols; x++) {
+            sums[label[x]] += pixel[x];
+        }
+
+    }
+
+    vector<Blob> blobs;
+
+    // Label 0 is background
+    for (int i = 1; i < label_count; i++) {
+
+        int area = statistics.at<int>(i, CC_STAT_AREA);
+
+        if (area < settings->MIN_BLOB_AREA || area > settings->MAX_BLOB_AREA) {
+            continue;
+        }
+
+        Blob blob;
+        blob.bounding_box = Rect(statistics.at<int>(i, CC_STAT_LEFT), statistics.at<int>(i, CC_STAT_TOP), statistics.at<int>(i, CC_STAT_WIDTH), statistics.at<int>(i, CC_STAT_HEIGHT));
+        blob.area = area;
+        blob.mean = sums[i] / (255. * area);
+
+        // Strong back projection first, then size
+        blob.score = blob.mean * sqrt((double) area);
+
+        blobs.push_back(blob);
+
+    }
+
+    sort(blobs.begin(), blobs.end(), compare_blobs);
+
+    return blobs;
+}
+
+/**
+ * Threshold, erode and dilate bands of the back projection into the mask.
+ *
+ * @param back_projection
+ * @param range range of bands
+ * @param band_rows rows of one band
+ */
+void BlobDetector::filter_bands(const Mat& back_projection, const Range& range, int band_rows) {
+
+    int halo = settings->erode_size + settings->dilate_size;
+
+    Mat erode_element = getStructuringElement(MORPH_RECT, Size(settings->erode_size, settings->erode_size));
+    Mat dilate_element = getStructuringElement(MORPH_RECT, Size(settings->dilate_size, settings->dilate_size));
+
+    for (int band = range.start; band < range.end; band++) {
+
+        int top = band * band_rows;
+        int bottom = min(top + band_rows, back_projection.rows);
+
+        // Band with halo rows above and below
+        int halo_top = max(top - halo, 0);
+        int halo_bottom = min(bottom + halo, back_projection.rows);
+
+        Mat band_mask;
+        threshold(back_projection.rowRange(halo_top, halo_bottom), band_mask, settings->blob_threshold, 255, THRESH_BINARY);
+
+        erode(band_mask, band_mask, erode_element);
+        dilate(band_mask, band_mask, dilate_element);
+
+        // Only the rows not affected by the band border are kept
+        Mat mask_band = mask.rowRange(top, bottom);
+        band_mask.rowRange(top - halo_top, bottom - halo_top).copyTo(mask_band);
+
+    }
+}
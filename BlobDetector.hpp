@@ -0,0 +1,72 @@
+/*
+ * File:   BlobDetector.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef BLOBDETECTOR_HPP
+#define BLOBDETECTOR_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Connected blob of back projection.
+ */
+struct Blob {
+
+    // Bounding box of the blob
+    Rect bounding_box;
+
+    // Number of pixels of the blob
+    int area = 0;
+
+    // Mean back projection over the blob pixels in range 0-1
+    double mean = 0;
+
+    // Ranking score, higher is better
+    double score = 0;
+
+};
+
+/**
+ * Global blob detector for reacquisition of a lost victim.
+ *
+ * Back projection is thresholded, eroded and dilated in horizontal bands
+ * on the thread pool. Each band carries enough halo rows for erosion
+ * followed by dilation. Connected components of the resulting mask are
+ * then ranked by how strongly and how largely they back project.
+ */
+class BlobDetector {
+public:
+
+    BlobDetector(Settings&);
+    BlobDetector(const BlobDetector& orig) = delete;
+    BlobDetector& operator=(const BlobDetector& orig) = delete;
+    virtual ~BlobDetector();
+
+    vector<Blob> detect(const Mat&);
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Thresholded and morphologically filtered back projection
+    Mat mask;
+
+    // Connected components
+    Mat labels;
+    Mat statistics;
+    Mat centroids;
+
+    void filter_bands(const Mat&, const Range&, int);
+
+    friend class FilterBandsInvoker;
+
+};
+
+#endif /* BLOBDETECTOR_HPP */
+
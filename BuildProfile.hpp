@@ -0,0 +1,53 @@
+/*
+ * File:   BuildProfile.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef BUILDPROFILE_HPP
+#define BUILDPROFILE_HPP
+
+////////////////////////////////////////////////////////////////////////////////
+// Deployment profiles
+//
+// A profile fixes parameters that never change on its hardware. They become
+// compile time constants of Settings, so branches on them fold away. Only
+// the histogram size selects a specialized kernel, the blur kernel size is
+// passed to GaussianBlur as before and OpenCV builds the kernel at runtime.
+// Parameters a profile does not fix stay tunable at runtime. The profile is
+// selected by CMake:
+//
+//     cmake -DEMILY_PROFILE=sbc .
+//
+// The user interface is a separate option, -DEMILY_USER_INTERFACE=OFF.
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(EMILY_PROFILE_SBC)
+
+// Single board computer on the boat without display
+
+// Blur kernel tuned for the boat camera at the processing resolution
+#define PROFILE_BLUR_KERNEL_SIZE 9
+
+// Hue histogram bins, only this back projection kernel is compiled
+#define PROFILE_HISTOGRAM_SIZE 16
+
+// BGR lookup is not fixed on, it stays a runtime choice until it has been
+// measured with color adaptation on the board
+
+// Frames are processed at 480 lines at most
+#define PROFILE_PROCESSING_HEIGHT_LIMIT 480
+
+#endif
+
+// Defaults of the desktop profile
+
+#ifndef PROFILE_PROCESSING_HEIGHT_LIMIT
+#define PROFILE_PROCESSING_HEIGHT_LIMIT 1200
+#endif
+
+#if defined(PROFILE_BLUR_KERNEL_SIZE) && PROFILE_BLUR_KERNEL_SIZE % 2 == 0
+#error "PROFILE_BLUR_KERNEL_SIZE has to be odd"
+#endif
+
+#endif /* BUILDPROFILE_HPP */
+
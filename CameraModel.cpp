@@ -0,0 +1,153 @@
+/*
+ * File:   CameraModel.cpp
+ * Author: Jan Dufek
+ */
+
+#include "CameraModel.hpp"
+
+/**
+ * Scale calibration data from calibration resolution to processing resolution.
+ *
+ * Scaling is only valid for the same sensor at another resolution. A
+ * source with another aspect ratio is cropped or stretched differently, so
+ * it stays uncalibrated and bearings are not computed for it.
+ *
+ * @param settings
+ * @param processing_size
+ */
+CameraModel::CameraModel(Settings& settings, Size processing_size) {
+
+    size = processing_size;
+
+    // Calibration is opt in for the configured camera
+    if (!settings.compute_bearing && !settings.undistort_frame) {
+        return;
+    }
+
+    if (settings.camera_intrinsic_matrix.empty() || settings.camera_calibration_size.area() == 0) {
+        return;
+    }
+
+    double scale_x = (double) size.width / settings.camera_calibration_size.width;
+    double scale_y = (double) size.height / settings.camera_calibration_size.height;
+
+    // Aspect ratios within a pixel of rounding are the same camera
+    if (fabs(scale_x - scale_y) * max(settings.camera_calibration_size.width, settings.camera_calibration_size.height) > 1) {
+        cout << "Calibration is for " << settings.camera_calibration_size.width << "x" << settings.camera_calibration_size.height << ", not for " << size.width << "x" << size.height << ". Bearing disabled." << endl;
+        return;
+    }
+
+    settings.camera_intrinsic_matrix.convertTo(intrinsic_matrix, CV_64F);
+    settings.camera_distortion_vector.convertTo(distortion_vector, CV_64F);
+
+    // Focal lengths scale with resolution, principal point in pixel centers
+    intrinsic_matrix.at<double>(0, 0) *= scale_x;
+    intrinsic_matrix.at<double>(1, 1) *= scale_y;
+    intrinsic_matrix.at<double>(0, 2) = (intrinsic_matrix.at<double>(0, 2) + 0.5) * scale_x - 0.5;
+    intrinsic_matrix.at<double>(1, 2) = (intrinsic_matrix.at<double>(1, 2) + 0.5) * scale_y - 0.5;
+
+}
+
+CameraModel::~CameraModel() {
+}
+
+/**
+ * Check whether calibration data is available.
+ *
+ * @return
+ */
+bool CameraModel::is_calibrated() const {
+    return !intrinsic_matrix.empty();
+}
+
+/**
+ * Angle between two rays given by normalized image coordinates.
+ *
+ * @param a
+ * @param b
+ * @return angle in degrees
+ */
+double CameraModel::ray_angle(const Point2f& a, const Point2f& b) {
+
+    double dot = a.x * b.x + a.y * b.y + 1.;
+    double norm_a = sqrt(a.x * a.x + a.y * a.y + 1.);
+    double norm_b = sqrt(b.x * b.x + b.y * b.y + 1.);
+
+    return acos(min(max(dot / (norm_a * norm_b), -1.), 1.)) * 180. / CV_PI;
+}
+
+/**
+ * Undistort center and corners of the box and compute bearing and angular size.
+ *
+ * @param box tracking box in processing resolution
+ * @return
+ */
+TargetBearing CameraModel::bearing(const RotatedRect& box) const {
+
+    TargetBearing bearing;
+
+    if (!is_calibrated() || box.size.width <= 0 || box.size.height <= 0) {
+        return bearing;
+    }
+
+    // Center followed by the corners
+    vector<Point2f> points(5);
+    points[0] = box.center;
+    box.points(&points[1]);
+
+    // Normalized image coordinates, that is rays with z = 1
+    vector<Point2f> rays;
+
+    if (frame_undistorted) {
+        undistortPoints(points, rays, intrinsic_matrix, Mat());
+    } else {
+        undistortPoints(points, rays, intrinsic_matrix, distortion_vector);
+    }
+
+    const Point2f& center = rays[0];
+
+    bearing.undistorted_center.x = (float) (center.x * intrinsic_matrix.at<double>(0, 0) + intrinsic_matrix.at<double>(0, 2));
+    bearing.undistorted_center.y = (float) (center.y * intrinsic_matrix.at<double>(1, 1) + intrinsic_matrix.at<double>(1, 2));
+
+    // Image y grows down, elevation grows up
+    bearing.azimuth = atan(center.x) * 180. / CV_PI;
+    bearing.elevation = atan2(-center.y, sqrt(1. + center.x * center.x)) * 180. / CV_PI;
+
+    // Corners are bottom left, top left, top right and bottom right. Width
+    // spans the left and right side, height the top and bottom side.
+    Point2f left = (rays[1] + rays[2]) * 0.5;
+    Point2f right = (rays[3] + rays[4]) * 0.5;
+    Point2f top = (rays[2] + rays[3]) * 0.5;
+    Point2f bottom = (rays[4] + rays[1]) * 0.5;
+
+    bearing.angular_width = ray_angle(left, right);
+    bearing.angular_height = ray_angle(top, bottom);
+
+    bearing.valid = true;
+
+    return bearing;
+}
+
+/**
+ * Remove lens distortion from the whole frame. Once used, bearings treat
+ * frames as undistorted.
+ *
+ * @param frame frame in processing resolution
+ */
+void CameraModel::undistort_frame(Mat& frame) {
+
+    if (!is_calibrated()) {
+        return;
+    }
+
+    if (undistort_map_1.empty()) {
+        initUndistortRectifyMap(intrinsic_matrix, distortion_vector, Mat(), intrinsic_matrix, size, CV_16SC2, undistort_map_1, undistort_map_2);
+    }
+
+    // Remap cannot work in place, and the frame may be owned by the caller
+    Mat undistorted;
+    remap(frame, undistorted, undistort_map_1, undistort_map_2, INTER_LINEAR);
+    frame = undistorted;
+
+    frame_undistorted = true;
+}
@@ -0,0 +1,82 @@
+/*
+ * File:   CameraModel.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef CAMERAMODEL_HPP
+#define CAMERAMODEL_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Geometrically corrected position of the victim.
+ */
+struct TargetBearing {
+
+    // Bearing was computed for the current box
+    bool valid = false;
+
+    // Center of the box after undistortion, in pixels
+    Point2f undistorted_center;
+
+    // Horizontal angle of the center from the optical axis in degrees, positive to the right
+    double azimuth = 0;
+
+    // Vertical angle of the center from the optical axis in degrees, positive up
+    double elevation = 0;
+
+    // Angle subtended by the box width and height in degrees
+    double angular_width = 0;
+    double angular_height = 0;
+
+};
+
+/**
+ * Camera intrinsics and distortion scaled to the processing resolution.
+ *
+ * Only the tracked center and the box corners are undistorted, which costs
+ * a few point undistortions per frame instead of a full-frame remap. The
+ * remap of the whole frame is available for display but off by default.
+ */
+class CameraModel {
+public:
+
+    CameraModel(Settings&, Size);
+    CameraModel(const CameraModel& orig) = delete;
+    CameraModel& operator=(const CameraModel& orig) = delete;
+    virtual ~CameraModel();
+
+    TargetBearing bearing(const RotatedRect&) const;
+
+    void undistort_frame(Mat&);
+
+    bool is_calibrated() const;
+
+private:
+
+    // Intrinsic matrix scaled to processing resolution
+    Mat intrinsic_matrix;
+
+    // Distortion coefficients
+    Mat distortion_vector;
+
+    // Maps for full-frame undistortion, created on first use
+    Mat undistort_map_1;
+    Mat undistort_map_2;
+
+    // Processing resolution
+    Size size;
+
+    // Frames are already undistorted, so points are not undistorted again
+    bool frame_undistorted = false;
+
+    static double ray_angle(const Point2f&, const Point2f&);
+
+};
+
+#endif /* CAMERAMODEL_HPP */
+
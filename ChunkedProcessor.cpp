@@ -0,0 +1,463 @@
+/*
+ * File:   ChunkedProcessor.cpp
+ * Author: Jan Dufek
+ */
+
+#include "ChunkedProcessor.hpp"
+#include "VictimTracker.hpp"
+#include "TrackRecorder.hpp"
+
+#include <new>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+ChunkedProcessor::ChunkedProcessor(Settings& s) {
+
+    settings = &s;
+
+    fps = 0;
+    frame_count = 0;
+
+    next_chunk = NULL;
+    records = NULL;
+    record_count = 0;
+
+}
+
+ChunkedProcessor::~ChunkedProcessor() {
+}
+
+/**
+ * Find keyframes from the packet flags reported by ffprobe. Packets are
+ * only demuxed, not decoded, so this takes seconds even for hours of video.
+ * The number of packets replaces the frame count estimated by the backend.
+ *
+ * @return false if ffprobe is not available or found no keyframes
+ */
+bool ChunkedProcessor::index_keyframes() {
+
+    int descriptors[2];
+
+    if (pipe(descriptors) != 0) {
+        return false;
+    }
+
+    pid_t probe_process = fork();
+
+    if (probe_process == 0) {
+        dup2(descriptors[1], STDOUT_FILENO);
+        close(descriptors[0]);
+        close(descriptors[1]);
+        execlp("ffprobe", "ffprobe", "-v", "error", "-select_streams", "v:0", "-show_entries", "packet=pts_time,flags", "-of", "csv=p=0", source.c_str(), (char *) NULL);
+        _exit(127);
+    }
+
+    close(descriptors[1]);
+
+    if (probe_process < 0) {
+        close(descriptors[0]);
+        return false;
+    }
+
+    FILE * probe = fdopen(descriptors[0], "r");
+
+    vector<double> keyframe_times;
+    double first_time = -1;
+    int64 packets = 0;
+    char line[256];
+
+    while (probe != NULL && fgets(line, sizeof (line), probe) != NULL) {
+
+        double time;
+        char flags[32];
+
+        // Packets without time stamp have N/A and are skipped
+        if (sscanf(line, "%lf,%31s", &time, flags) != 2) {
+            continue;
+        }
+
+        packets++;
+
+        if (first_time < 0 || time < first_time) {
+            first_time = time;
+        }
+
+        if (strchr(flags, 'K') != NULL) {
+            keyframe_times.push_back(time);
+        }
+    }
+
+    if (probe != NULL) {
+        fclose(probe);
+    } else {
+        close(descriptors[0]);
+    }
+
+    waitpid(probe_process, NULL, 0);
+
+    keyframes.clear();
+
+    for (size_t i = 0; i < keyframe_times.size(); i++) {
+        keyframes.push_back(cvRound((keyframe_times[i] - first_time) * fps));
+    }
+
+    sort(keyframes.begin(), keyframes.end());
+    keyframes.erase(unique(keyframes.begin(), keyframes.end()), keyframes.end());
+
+    if (keyframes.empty()) {
+        return false;
+    }
+
+    frame_count = packets;
+
+    return true;
+}
+
+/**
+ * Get the last keyframe at or before a frame. Without an index every
+ * frame is taken as a keyframe.
+ *
+ * @param frame
+ * @return
+ */
+int64 ChunkedProcessor::keyframe_before(int64 frame) const {
+
+    if (keyframes.empty()) {
+        return frame;
+    }
+
+    vector<int64>::const_iterator after = upper_bound(keyframes.begin(), keyframes.end(), frame);
+
+    return after == keyframes.begin() ? 0 : *(after - 1);
+}
+
+/**
+ * Split the file into chunks starting at keyframes and lay out their
+ * records.
+ *
+ * @param workers
+ */
+void ChunkedProcessor::split(int workers) {
+
+    int count = max(workers * settings->chunks_per_worker, 1);
+    int64 warmup = cvRound(settings->chunk_warmup_seconds * fps);
+
+    vector<int64> starts;
+    starts.push_back(0);
+
+    for (int i = 1; i < count; i++) {
+
+        int64 start = keyframe_before(frame_count * i / count);
+
+        if (start > starts.back()) {
+            starts.push_back(start);
+        }
+    }
+
+    chunks.clear();
+    record_count = 0;
+
+    for (size_t i = 0; i < starts.size(); i++) {
+
+        Chunk chunk;
+        chunk.start = starts[i];
+        chunk.end = (i + 1 < starts.size()) ? starts[i + 1] : frame_count;
+        chunk.decode_start = (i == 0) ? 0 : keyframe_before(max(chunk.start - warmup, (int64) 0));
+        chunk.first_record = record_count;
+
+        record_count += chunk.end - chunk.decode_start;
+
+        chunks.push_back(chunk);
+    }
+}
+
+/**
+ * Track one chunk, warm-up included, into the shared records.
+ *
+ * @param chunk
+ * @return false if the source cannot be opened
+ */
+bool ChunkedProcessor::track_chunk(const Chunk& chunk) {
+
+    VideoCapture video_capture(source);
+
+    if (!video_capture.isOpened()) {
+        return false;
+    }
+
+    // Decoding starts at a keyframe, so the seek is exact
+    if (chunk.decode_start > 0) {
+        video_capture.set(CV_CAP_PROP_POS_FRAMES, chunk.decode_start);
+    }
+
+    VictimTracker tracker(frame_size, fps, SINK_NONE);
+
+    Mat frame;
+
+    for (int64 frame_number = chunk.decode_start; frame_number < chunk.end && video_capture.read(frame); frame_number++) {
+
+        TrackingResult result = tracker.push(frame);
+
+        ChunkRecord& record = records[chunk.first_record + (frame_number - chunk.decode_start)];
+
+        record.valid = result.valid;
+        record.x = result.center.x;
+        record.y = result.center.y;
+        record.width = result.size.width;
+        record.height = result.size.height;
+        record.angle = result.angle;
+        record.confidence = result.confidence;
+        record.written = 1;
+    }
+
+    return true;
+}
+
+/**
+ * Take chunks until none are left. Runs in a worker process.
+ */
+void ChunkedProcessor::work() {
+
+    // One core per worker, the workers already fill the machine
+    setNumThreads(1);
+
+    while (true) {
+
+        int index = next_chunk->fetch_add(1);
+
+        if (index >= (int) chunks.size()) {
+            break;
+        }
+
+        if (!track_chunk(chunks[index])) {
+            cout << "Cannot open " << source << " for chunk " << index << endl;
+        }
+    }
+}
+
+/**
+ * Check whether two tracks of the same frame see the same victim. Two
+ * tracks which both lost the victim agree as well.
+ *
+ * @param first
+ * @param second
+ * @return
+ */
+bool ChunkedProcessor::agree(const ChunkRecord& first, const ChunkRecord& second) const {
+
+    if (!first.written || !second.written) {
+        return false;
+    }
+
+    if (!first.valid || !second.valid) {
+        return !first.valid && !second.valid;
+    }
+
+    float side = max(max(first.width, first.height), max(second.width, second.height));
+
+    return hypot(first.x - second.x, first.y - second.y) < settings->chunk_stitch_distance * side;
+}
+
+/**
+ * Find the frame where the output switches from one chunk to the next. It
+ * is the frame after the last disagreement in the overlap, so the next
+ * chunk takes over only once its track has settled on the same victim.
+ *
+ * @param previous
+ * @param next
+ * @return
+ */
+int64 ChunkedProcessor::stitch_point(const Chunk& previous, const Chunk& next) const {
+
+    int64 begin = max(next.decode_start, previous.start);
+    int64 switch_frame = begin;
+
+    for (int64 frame_number = begin; frame_number < next.start; frame_number++) {
+
+        const ChunkRecord& first = records[previous.first_record + (frame_number - previous.decode_start)];
+        const ChunkRecord& second = records[next.first_record + (frame_number - next.decode_start)];
+
+        if (!agree(first, second)) {
+            switch_frame = frame_number + 1;
+        }
+    }
+
+    return switch_frame;
+}
+
+/**
+ * Stitch the chunks into one track file.
+ *
+ * @param output_name file name without extension
+ */
+void ChunkedProcessor::write_track(const string& output_name) {
+
+    TrackRecorder track_recorder(output_name, frame_size, fps);
+    track_recorder.copy_source(source);
+
+    int64 from = 0;
+    int64 missing = 0;
+    int unsettled = 0;
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+
+        const Chunk& chunk = chunks[i];
+
+        int64 to = chunk.end;
+
+        if (i + 1 < chunks.size()) {
+
+            to = stitch_point(chunk, chunks[i + 1]);
+
+            // The next chunk still disagreed at the boundary
+            if (to == chunk.end) {
+                unsettled++;
+            }
+        }
+
+        for (int64 frame_number = from; frame_number < to; frame_number++) {
+
+            const ChunkRecord& record = records[chunk.first_record + (frame_number - chunk.decode_start)];
+
+            TrackingResult result;
+            result.frame_number = frame_number;
+
+            if (!record.written) {
+                missing++;
+            } else if (record.valid) {
+                result.valid = true;
+                result.center = Point2f(record.x, record.y);
+                result.size = Size2f(record.width, record.height);
+                result.angle = record.angle;
+                result.confidence = record.confidence;
+            }
+
+            track_recorder.write(result, 0, frame_number * 1000. / fps);
+        }
+
+        from = to;
+    }
+
+    if (unsettled > 0) {
+        cout << unsettled << " of " << chunks.size() - 1 << " chunk boundaries did not settle within the warm-up" << endl;
+    }
+
+    if (missing > 0) {
+        cout << missing << " frames could not be decoded" << endl;
+    }
+}
+
+/**
+ * Track a video file in parallel chunks.
+ *
+ * @param source_name video file
+ * @param workers number of worker processes, or 0 for one per core
+ * @return 0 on success, -1 on error
+ */
+int ChunkedProcessor::run(const string& source_name, int workers) {
+
+    source = source_name;
+
+    VideoCapture video_capture(source);
+
+    if (!video_capture.isOpened()) {
+        cout << "Cannot open " << source << endl;
+        return -1;
+    }
+
+    fps = video_capture.get(CV_CAP_PROP_FPS);
+    if (fps <= 0) {
+        fps = 30;
+    }
+
+    frame_size = Size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+    frame_count = (int64) video_capture.get(CV_CAP_PROP_FRAME_COUNT);
+
+    // Decoder threads must not be running when the workers are forked
+    video_capture.release();
+
+    if (!index_keyframes()) {
+        cout << "Cannot index keyframes of " << source << " with ffprobe, chunks are seeked by frame number" << endl;
+    }
+
+    if (frame_count <= 0) {
+        cout << "Unknown length of " << source << endl;
+        return -1;
+    }
+
+    if (workers <= 0) {
+        workers = getNumberOfCPUs();
+    }
+
+    split(workers);
+
+    // Records are written by the workers and read here after they exit
+    size_t shared_bytes = sizeof (atomic<int>) + record_count * sizeof (ChunkRecord);
+    void * shared = mmap(NULL, shared_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (shared == MAP_FAILED) {
+        cout << "Cannot map " << shared_bytes << " bytes for chunk records" << endl;
+        return -1;
+    }
+
+    next_chunk = new (shared) atomic<int>(0);
+    records = (ChunkRecord *) ((char *) shared + sizeof (atomic<int>));
+
+    cout << "Tracking " << frame_count << " frames in " << chunks.size() << " chunks on " << workers << " workers" << endl;
+
+    int64 start_ticks = getTickCount();
+
+    vector<pid_t> worker_processes;
+
+    for (int i = 0; i < workers && i < (int) chunks.size(); i++) {
+
+        pid_t worker_process = fork();
+
+        if (worker_process == 0) {
+            work();
+            cout.flush();
+            _exit(0);
+        }
+
+        if (worker_process < 0) {
+            cout << "Cannot start worker " << i << endl;
+            break;
+        }
+
+        worker_processes.push_back(worker_process);
+    }
+
+    // Track here if no worker could be started
+    if (worker_processes.empty()) {
+        work();
+    }
+
+    for (size_t i = 0; i < worker_processes.size(); i++) {
+        waitpid(worker_processes[i], NULL, 0);
+    }
+
+    double seconds = (getTickCount() - start_ticks) / getTickFrequency();
+
+    // Output video name. It is in format year_month_day_hour_minute_second.
+    time_t raw_time;
+    time(&raw_time);
+    struct tm * local_time;
+    local_time = localtime(&raw_time);
+    char output_file_name[40];
+    strftime(output_file_name, 40, "output/%Y_%m_%d_%H_%M_%S", local_time);
+
+    write_track(output_file_name);
+
+    munmap(shared, shared_bytes);
+    next_chunk = NULL;
+    records = NULL;
+
+    cout << "Tracked " << frame_count / fps / 60 << " min of video in " << seconds / 60 << " min to " << output_file_name << ".track" << endl;
+
+    return 0;
+}
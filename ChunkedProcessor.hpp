@@ -0,0 +1,111 @@
+/*
+ * File:   ChunkedProcessor.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef CHUNKEDPROCESSOR_HPP
+#define CHUNKEDPROCESSOR_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Tracks a long recording on all cores after the mission.
+ *
+ * Keyframes of the file are indexed with ffprobe and the file is split at
+ * keyframes into chunks, so that every chunk is decoded from an exact seek.
+ * Worker processes take chunks from a shared counter and track each with a
+ * tracker of their own. Every chunk starts without a track, so the victim
+ * is first searched over the whole frame, and decoding starts
+ * chunk_warmup_seconds earlier to give the track time to settle.
+ *
+ * The warm-up overlaps the end of the previous chunk. At each boundary
+ * the output switches to the new chunk after the last frame where the two
+ * tracks disagree, and the result is written as one track file which can
+ * be rendered with --render.
+ */
+class ChunkedProcessor {
+public:
+
+    ChunkedProcessor(Settings&);
+    ChunkedProcessor(const ChunkedProcessor& orig) = delete;
+    ChunkedProcessor& operator=(const ChunkedProcessor& orig) = delete;
+    virtual ~ChunkedProcessor();
+
+    int run(const string&, int);
+
+private:
+
+    /**
+     * Result of one frame of one chunk, in memory shared with the workers.
+     */
+    struct ChunkRecord {
+        uint8_t written;
+        uint8_t valid;
+        float x;
+        float y;
+        float width;
+        float height;
+        float angle;
+        float confidence;
+    };
+
+    /**
+     * Frames of one chunk. Records of frames from decode_start on start at
+     * first_record.
+     */
+    struct Chunk {
+        int64 decode_start;
+        int64 start;
+        int64 end;
+        size_t first_record;
+    };
+
+    // Program settings
+    Settings * settings;
+
+    // Source video
+    string source;
+
+    // Source frame size, frame rate and number of frames
+    Size frame_size;
+    double fps;
+    int64 frame_count;
+
+    // Frame numbers of keyframes
+    vector<int64> keyframes;
+
+    vector<Chunk> chunks;
+
+    // Shared counter of the next chunk to process
+    atomic<int> * next_chunk;
+
+    // Shared records of all chunks
+    ChunkRecord * records;
+    size_t record_count;
+
+    bool index_keyframes();
+
+    int64 keyframe_before(int64) const;
+
+    void split(int);
+
+    bool track_chunk(const Chunk&);
+
+    void work();
+
+    bool agree(const ChunkRecord&, const ChunkRecord&) const;
+
+    int64 stitch_point(const Chunk&, const Chunk&) const;
+
+    void write_track(const string&);
+
+};
+
+#endif /* CHUNKEDPROCESSOR_HPP */
+
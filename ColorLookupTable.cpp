@@ -0,0 +1,139 @@
+/*
+ * File:   ColorLookupTable.cpp
+ * Author: Jan Dufek
+ */
+
+#include "ColorLookupTable.hpp"
+#include <string.h>
+
+ColorLookupTable::ColorLookupTable() {
+
+    bits = 0;
+    saturation_min = -1;
+    saturation_max = -1;
+
+    memset(hue_lut, 0, sizeof (hue_lut));
+    memset(hue_start, 0, sizeof (hue_start));
+
+}
+
+ColorLookupTable::~ColorLookupTable() {
+}
+
+/**
+ * Bring the table up to date with the hue lookup table, saturation limits
+ * and quantization.
+ *
+ * @param new_hue_lut hue to probability lookup table of the histogram
+ * @param new_saturation_min
+ * @param new_saturation_max
+ * @param new_bits bits per channel, 4 to 8
+ * @param tolerance hues whose probability changed by this much or less
+ * keep their cells
+ * @return true if any cell changed
+ */
+bool ColorLookupTable::update(const uchar * new_hue_lut, int new_saturation_min, int new_saturation_max, int new_bits, int tolerance) {
+
+    new_bits = min(max(new_bits, 4), 8);
+
+    // Adaptation of the histogram remaps only the cells of changed hues
+    if (new_bits == bits && new_saturation_min == saturation_min && new_saturation_max == saturation_max) {
+
+        bool changed = false;
+
+        for (int hue = 0; hue < 256; hue++) {
+
+            if (abs(new_hue_lut[hue] - hue_lut[hue]) <= tolerance) {
+                continue;
+            }
+
+            hue_lut[hue] = new_hue_lut[hue];
+
+            for (int i = hue_start[hue]; i < hue_start[hue + 1]; i++) {
+                table[hue_cells[i]] = hue_lut[hue];
+            }
+
+            changed = true;
+        }
+
+        return changed;
+    }
+
+    int cells = 1 << (3 * new_bits);
+
+    // Convert the cell centers once per quantization
+    if (new_bits != bits) {
+
+        int shift = 8 - new_bits;
+        int half = (1 << shift) >> 1;
+
+        Mat centers(cells, 1, CV_8UC3);
+
+        for (int cell = 0; cell < cells; cell++) {
+            uchar * center = centers.ptr<uchar>(cell);
+            center[0] = (uchar) (((cell >> (2 * new_bits)) << shift) | half);
+            center[1] = (uchar) ((((cell >> new_bits) & ((1 << new_bits) - 1)) << shift) | half);
+            center[2] = (uchar) (((cell & ((1 << new_bits) - 1)) << shift) | half);
+        }
+
+        cvtColor(centers, cell_hsv, COLOR_BGR2HSV);
+
+        table.resize(cells);
+    }
+
+    bits = new_bits;
+    saturation_min = new_saturation_min;
+    saturation_max = new_saturation_max;
+    memcpy(hue_lut, new_hue_lut, sizeof (hue_lut));
+
+    // Group saturated cells by hue, counting sort
+    memset(hue_start, 0, sizeof (hue_start));
+
+    for (int cell = 0; cell < cells; cell++) {
+        const uchar * hsv = cell_hsv.ptr<uchar>(cell);
+        if (hsv[1] >= saturation_min && hsv[1] <= saturation_max) {
+            hue_start[hsv[0] + 1]++;
+        }
+    }
+
+    for (int hue = 0; hue < 256; hue++) {
+        hue_start[hue + 1] += hue_start[hue];
+    }
+
+    hue_cells.resize(hue_start[256]);
+
+    int next[256];
+    memcpy(next, hue_start, sizeof (next));
+
+    for (int cell = 0; cell < cells; cell++) {
+
+        const uchar * hsv = cell_hsv.ptr<uchar>(cell);
+
+        if (hsv[1] >= saturation_min && hsv[1] <= saturation_max) {
+            hue_cells[next[hsv[0]]++] = cell;
+            table[cell] = hue_lut[hsv[0]];
+        } else {
+            table[cell] = 0;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Get the table, indexed by index().
+ *
+ * @return
+ */
+const uchar * ColorLookupTable::get_table() const {
+    return table.empty() ? NULL : &table[0];
+}
+
+/**
+ * Get bits per channel.
+ *
+ * @return
+ */
+int ColorLookupTable::get_bits() const {
+    return bits;
+}
@@ -0,0 +1,80 @@
+/*
+ * File:   ColorLookupTable.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef COLORLOOKUPTABLE_HPP
+#define COLORLOOKUPTABLE_HPP
+
+#include <vector>
+#include "opencv2/opencv.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Quantized BGR to probability table.
+ *
+ * Every cell of the BGR cube holds the hue back projection of its center
+ * color, already masked by the saturation limits. A pixel then costs one
+ * lookup instead of an HSV conversion. Value is not part of the table
+ * because its threshold follows the per-frame equalization, and value is
+ * simply the maximum of the three channels.
+ *
+ * HSV of the cell centers does not depend on the histogram, so it is
+ * converted once per quantization. Saturated cells are grouped by their
+ * hue, so when the adapted histogram changes only the cells of hues whose
+ * probability moved by more than a tolerance are rewritten. A change of
+ * the saturation limits or the quantization rebuilds the whole table.
+ */
+class ColorLookupTable {
+public:
+
+    ColorLookupTable();
+    ColorLookupTable(const ColorLookupTable& orig) = delete;
+    ColorLookupTable& operator=(const ColorLookupTable& orig) = delete;
+    virtual ~ColorLookupTable();
+
+    bool update(const uchar*, int, int, int, int = 0);
+
+    const uchar * get_table() const;
+
+    int get_bits() const;
+
+    /**
+     * Index of a BGR pixel in the table.
+     *
+     * @param pixel
+     * @param bits bits per channel
+     * @return
+     */
+    static inline int index(const uchar * pixel, int bits) {
+        int shift = 8 - bits;
+        return ((pixel[0] >> shift) << (2 * bits)) | ((pixel[1] >> shift) << bits) | (pixel[2] >> shift);
+    }
+
+private:
+
+    // Bits per channel, 0 until the first update
+    int bits;
+
+    // Probability of every cell
+    vector<uchar> table;
+
+    // HSV of the cell centers
+    Mat cell_hsv;
+
+    // Saturated cells ordered by hue. Cells of hue h are
+    // hue_cells[hue_start[h]] to hue_cells[hue_start[h + 1] - 1].
+    vector<int> hue_cells;
+    int hue_start[257];
+
+    // Inputs of the current table
+    uchar hue_lut[256];
+    int saturation_min;
+    int saturation_max;
+
+};
+
+#endif /* COLORLOOKUPTABLE_HPP */
+
@@ -0,0 +1,117 @@
+/*
+ * File:   ColorModel.cpp
+ * Author: Jan Dufek
+ */
+
+#include "ColorModel.hpp"
+
+ColorModel::ColorModel(Settings& s) {
+
+    settings = &s;
+
+}
+
+ColorModel::~ColorModel() {
+}
+
+/**
+ * Set the base model and start adapting from it.
+ *
+ * @param histogram histogram normalized to 0-255
+ */
+void ColorModel::set_base(const Mat& histogram) {
+
+    histogram.copyTo(base_histogram);
+
+    reset();
+}
+
+/**
+ * Go back to the base model.
+ */
+void ColorModel::reset() {
+
+    base_histogram.copyTo(current_histogram);
+
+    adaptations = 0;
+    rejections = 0;
+}
+
+/**
+ * Blend a histogram observed inside the tracking box into the model.
+ *
+ * @param observed hue histogram of counts with the bins of the model
+ * @param pixels number of pixels counted in the observed histogram
+ * @return true if the model changed
+ */
+bool ColorModel::adapt(const Mat& observed, int pixels) {
+
+    if (base_histogram.empty() || pixels < settings->color_adaptation_min_pixels) {
+        return false;
+    }
+
+    // Another object or background, do not learn from it
+    if (compareHist(current_histogram, observed, HISTCMP_BHATTACHARYYA) > settings->color_adaptation_max_distance) {
+
+        // The color changed faster than the model can follow
+        if (++rejections >= settings->color_adaptation_max_rejections && adaptations > 0) {
+            reset();
+            return true;
+        }
+
+        return false;
+    }
+
+    rejections = 0;
+
+    Mat normalized;
+    normalize(observed, normalized, 0, 255, NORM_MINMAX);
+
+    double rate = settings->color_adaptation_rate;
+    addWeighted(current_histogram, 1 - rate, normalized, rate, 0, current_histogram);
+    normalize(current_histogram, current_histogram, 0, 255, NORM_MINMAX);
+
+    adaptations++;
+
+    // Model drifted away from the jacket
+    if (compareHist(base_histogram, current_histogram, HISTCMP_BHATTACHARYYA) > settings->color_drift_limit) {
+        reset();
+    }
+
+    return true;
+}
+
+/**
+ * Get the current model.
+ *
+ * @return histogram normalized to 0-255
+ */
+const Mat& ColorModel::get_histogram() const {
+    return current_histogram;
+}
+
+/**
+ * Check whether the current model differs from the base.
+ *
+ * @return
+ */
+bool ColorModel::is_adapted() const {
+    return adaptations > 0;
+}
+
+/**
+ * Get the 16 bin hue histogram of a jacket color over hue range 0-180.
+ *
+ * @param preset
+ * @return histogram normalized to 0-255
+ */
+Mat ColorModel::preset_histogram(ColorPreset preset) {
+
+    switch (preset) {
+        case COLOR_PRESET_YELLOW:
+            return (Mat_<float>(16, 1) << 0, 0, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        case COLOR_PRESET_RED:
+        default:
+            return (Mat_<float>(16, 1) << 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255);
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * File:   ColorModel.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef COLORMODEL_HPP
+#define COLORMODEL_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Hue histogram of the victim which follows slow changes of its color.
+ *
+ * The base model comes from the preset or the manual selection. Hue
+ * histograms observed inside confident tracking boxes are blended into
+ * the current model exponentially. Observations that look too different
+ * from the current model are ignored, and a model that drifted too far
+ * from the base is rolled back to it.
+ */
+class ColorModel {
+public:
+
+    ColorModel(Settings&);
+    ColorModel(const ColorModel& orig) = delete;
+    ColorModel& operator=(const ColorModel& orig) = delete;
+    virtual ~ColorModel();
+
+    void set_base(const Mat&);
+
+    bool adapt(const Mat&, int);
+
+    void reset();
+
+    const Mat& get_histogram() const;
+
+    bool is_adapted() const;
+
+    static Mat preset_histogram(ColorPreset);
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Model from the preset or manual selection, normalized to 0-255
+    Mat base_histogram;
+
+    // Adapted model, normalized to 0-255
+    Mat current_histogram;
+
+    // Number of blended observations since the last reset
+    int adaptations = 0;
+
+    // Number of observations rejected in a row
+    int rejections = 0;
+
+};
+
+#endif /* COLORMODEL_HPP */
+
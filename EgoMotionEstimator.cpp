@@ -0,0 +1,103 @@
+/*
+ * File:   EgoMotionEstimator.cpp
+ * Author: Jan Dufek
+ */
+
+#include "EgoMotionEstimator.hpp"
+
+EgoMotionEstimator::EgoMotionEstimator(Settings& s) {
+    settings = &s;
+}
+
+EgoMotionEstimator::~EgoMotionEstimator() {
+}
+
+/**
+ * Estimate the shift of the frame since the previous processed frame.
+ *
+ * @param frame BGR frame
+ * @param motion shift in pixels of the frame, content at p moved to
+ * p + motion
+ * @return false for the first frame and for rejected estimates, the
+ * motion is then zero
+ */
+bool EgoMotionEstimator::estimate(const Mat& frame, Point2f& motion) {
+
+    motion = Point2f();
+
+    // Area interpolation averages out sensor noise and small waves
+    int width = max(settings->ego_motion_thumbnail_width, 16);
+    int height = max(width * frame.rows / max(frame.cols, 1), 16);
+
+    Mat small;
+    Mat gray;
+    resize(frame, small, Size(width, height), 0, 0, INTER_AREA);
+    cvtColor(small, gray, COLOR_BGR2GRAY);
+    gray.convertTo(thumbnail, CV_32F);
+
+    if (window.size() != thumbnail.size()) {
+        createHanningWindow(window, thumbnail.size(), CV_32F);
+    }
+
+    bool accepted = false;
+
+    if (reference_thumbnail.size() == thumbnail.size()) {
+
+        estimates++;
+
+        Point2d shift = phaseCorrelate(reference_thumbnail, thumbnail, window, &response);
+
+        double scale = (double) frame.cols / width;
+        Point2f frame_shift(shift.x * scale, shift.y * scale);
+        double length = hypot(frame_shift.x, frame_shift.y);
+
+        if (response >= settings->ego_motion_min_response && length <= settings->ego_motion_max_shift * frame.cols) {
+
+            motion = frame_shift;
+            accepted = true;
+
+            accepted_estimates++;
+            total_shift += length;
+            largest_shift = max(largest_shift, length);
+        }
+
+    } else {
+
+        response = 0;
+
+    }
+
+    thumbnail.copyTo(reference_thumbnail);
+
+    return accepted;
+}
+
+/**
+ * Get the correlation peak of the last estimate.
+ *
+ * @return
+ */
+double EgoMotionEstimator::get_response() {
+    return response;
+}
+
+/**
+ * Print how often the shift was accepted and how large it was.
+ */
+void EgoMotionEstimator::print_statistics() {
+
+    if (estimates == 0) {
+        return;
+    }
+
+    cout << "Ego-motion estimates: " << estimates;
+    cout << " Accepted: " << accepted_estimates << " (" << 100. * accepted_estimates / estimates << " %)";
+
+    if (accepted_estimates > 0) {
+        cout << " Mean shift: " << total_shift / accepted_estimates << " px";
+        cout << " Largest shift: " << largest_shift << " px";
+    }
+
+    cout << endl;
+
+}
@@ -0,0 +1,65 @@
+/*
+ * File:   EgoMotionEstimator.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef EGOMOTIONESTIMATOR_HPP
+#define EGOMOTIONESTIMATOR_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Global image shift caused by pitch and roll of the boat.
+ *
+ * Each processed frame is reduced to a small grayscale thumbnail and phase
+ * correlated with the thumbnail of the previous processed frame. The
+ * horizon and the large wave pattern dominate the correlation, the victim
+ * is too small to move the peak. Shifts with a weak correlation peak or
+ * larger than the limit are rejected, so a scene change does not throw
+ * the search window away.
+ */
+class EgoMotionEstimator {
+public:
+
+    EgoMotionEstimator(Settings&);
+    EgoMotionEstimator(const EgoMotionEstimator& orig) = delete;
+    EgoMotionEstimator& operator=(const EgoMotionEstimator& orig) = delete;
+    virtual ~EgoMotionEstimator();
+
+    bool estimate(const Mat&, Point2f&);
+
+    double get_response();
+
+    void print_statistics();
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Floating point grayscale thumbnail of the current frame
+    Mat thumbnail;
+
+    // Thumbnail of the previous processed frame
+    Mat reference_thumbnail;
+
+    // Hanning window against the edge effects of the transform
+    Mat window;
+
+    // Peak of the last correlation, 0-1
+    double response = 0;
+
+    // Statistics
+    long estimates = 0;
+    long accepted_estimates = 0;
+    double total_shift = 0;
+    double largest_shift = 0;
+
+};
+
+#endif /* EGOMOTIONESTIMATOR_HPP */
+
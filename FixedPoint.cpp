@@ -0,0 +1,166 @@
+/*
+ * File:   FixedPoint.cpp
+ * Author: Jan Dufek
+ */
+
+#include "FixedPoint.hpp"
+
+// Number of CORDIC iterations
+static const int CORDIC_ITERATIONS = 16;
+
+// atan(2^-i) in Q16 radians
+static const int32_t CORDIC_ANGLES[CORDIC_ITERATIONS] = {
+    51472, 30386, 16055, 8150, 4091, 2047, 1024, 512,
+    256, 128, 64, 32, 16, 8, 4, 2
+};
+
+// Reciprocal of CORDIC gain in Q16
+static const int32_t CORDIC_INVERSE_GAIN = 39797;
+
+/**
+ * Integer square root rounded down.
+ *
+ * @param value
+ * @return
+ */
+uint64_t FixedPoint::sqrt(uint64_t value) {
+
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t) 1 << 62;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return result;
+}
+
+/**
+ * Angle of vector (x, y) by CORDIC in vectoring mode.
+ *
+ * @param y
+ * @param x
+ * @return angle in range -PI to PI in Q16 radians
+ */
+int32_t FixedPoint::atan2(int64_t y, int64_t x) {
+
+    if (x == 0 && y == 0) {
+        return 0;
+    }
+
+    // Rotate into the right half plane
+    int32_t angle = 0;
+    if (x < 0) {
+        angle = (y >= 0) ? PI : -PI;
+        x = -x;
+        y = -y;
+    }
+
+    // Scale down so that the iterations cannot overflow
+    while (x > ((int64_t) 1 << 29) || y > ((int64_t) 1 << 29) || y < -((int64_t) 1 << 29)) {
+        x >>= 1;
+        y >>= 1;
+    }
+
+    // Scale up short vectors so that truncated shifts do not dominate
+    while (x < ((int64_t) 1 << 28) && y < ((int64_t) 1 << 28) && y > -((int64_t) 1 << 28)) {
+        x <<= 1;
+        y <<= 1;
+    }
+
+    for (int i = 0; i < CORDIC_ITERATIONS; i++) {
+
+        int64_t shifted_x = x >> i;
+        int64_t shifted_y = y >> i;
+
+        if (y > 0) {
+            x += shifted_y;
+            y -= shifted_x;
+            angle += CORDIC_ANGLES[i];
+        } else {
+            x -= shifted_y;
+            y += shifted_x;
+            angle -= CORDIC_ANGLES[i];
+        }
+
+    }
+
+    // Keep result in range after the half plane rotation
+    if (angle > PI) {
+        angle -= 2 * PI;
+    } else if (angle < -PI) {
+        angle += 2 * PI;
+    }
+
+    return angle;
+}
+
+/**
+ * Sine and cosine by CORDIC in rotation mode.
+ *
+ * @param angle angle in range -PI to PI in Q16 radians
+ * @param sine sine in Q16
+ * @param cosine cosine in Q16
+ */
+void FixedPoint::sin_cos(int32_t angle, int32_t& sine, int32_t& cosine) {
+
+    // CORDIC converges for angles up to about PI / 2, so fold the rest
+    bool negate = false;
+    if (angle > PI / 2) {
+        angle -= PI;
+        negate = true;
+    } else if (angle < -PI / 2) {
+        angle += PI;
+        negate = true;
+    }
+
+    int64_t x = CORDIC_INVERSE_GAIN;
+    int64_t y = 0;
+    int64_t z = angle;
+
+    for (int i = 0; i < CORDIC_ITERATIONS; i++) {
+
+        int64_t shifted_x = x >> i;
+        int64_t shifted_y = y >> i;
+
+        if (z >= 0) {
+            x -= shifted_y;
+            y += shifted_x;
+            z -= CORDIC_ANGLES[i];
+        } else {
+            x += shifted_y;
+            y -= shifted_x;
+            z += CORDIC_ANGLES[i];
+        }
+
+    }
+
+    cosine = (int32_t) (negate ? -x : x);
+    sine = (int32_t) (negate ? -y : y);
+}
+
+/**
+ * Signed integer division rounded to nearest, halves away from zero.
+ *
+ * @param numerator
+ * @param denominator must be positive
+ * @return
+ */
+int64_t FixedPoint::divide_round(int64_t numerator, int64_t denominator) {
+
+    if (numerator >= 0) {
+        return (numerator + denominator / 2) / denominator;
+    } else {
+        return -((-numerator + denominator / 2) / denominator);
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * File:   FixedPoint.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef FIXEDPOINT_HPP
+#define FIXEDPOINT_HPP
+
+#include <stdint.h>
+
+/**
+ * Integer math used by the fixed point tracking path.
+ *
+ * Angles are in radians in Q16 (65536 is one radian). Sine and cosine are
+ * in Q16 as well. CORDIC runs 16 iterations with a Q16 angle table, so
+ * atan2 is within 6e-5 rad (0.0035 degrees) for any nonzero vector, and
+ * sine and cosine are within 2e-4 (13 units in Q16).
+ */
+class FixedPoint {
+public:
+
+    // Number of fractional bits of angles, sines and cosines
+    static const int ANGLE_BITS = 16;
+
+    // Pi in Q16
+    static const int32_t PI = 205887;
+
+    static uint64_t sqrt(uint64_t);
+
+    static int32_t atan2(int64_t, int64_t);
+
+    static void sin_cos(int32_t, int32_t&, int32_t&);
+
+    static int64_t divide_round(int64_t, int64_t);
+
+};
+
+#endif /* FIXEDPOINT_HPP */
+
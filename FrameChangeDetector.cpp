@@ -0,0 +1,119 @@
+/*
+ * File:   FrameChangeDetector.cpp
+ * Author: Jan Dufek
+ */
+
+#include "FrameChangeDetector.hpp"
+
+FrameChangeDetector::FrameChangeDetector(Settings& s) {
+    settings = &s;
+}
+
+FrameChangeDetector::~FrameChangeDetector() {
+}
+
+/**
+ * Decide how much of the frame has to be processed.
+ *
+ * @param frame current frame
+ * @param region_possible whether the current track allows processing only
+ * a region around the victim
+ * @return
+ */
+FrameChange FrameChangeDetector::classify(const Mat& frame, bool region_possible) {
+
+    total_frames++;
+
+    // Tiny grayscale thumbnail. Area interpolation averages out sensor noise.
+    int width = max(settings->change_thumbnail_width, 1);
+    int height = max(width * frame.rows / max(frame.cols, 1), 1);
+
+    Mat small;
+    resize(frame, small, Size(width, height), 0, 0, INTER_AREA);
+    cvtColor(small, thumbnail, COLOR_BGR2GRAY);
+
+    FrameChange change = FRAME_CHANGED;
+
+    if (reference_thumbnail.size() == thumbnail.size() && frames_since_full < settings->change_full_frame_interval) {
+
+        Mat absolute_difference;
+        absdiff(thumbnail, reference_thumbnail, absolute_difference);
+        difference = sum(absolute_difference)[0] / thumbnail.total();
+        minMaxLoc(absolute_difference, NULL, &largest_difference);
+
+        if (difference < settings->change_static_threshold && largest_difference < settings->change_cell_threshold) {
+            change = FRAME_STATIC;
+        } else if (difference < settings->change_small_threshold && region_possible) {
+            change = FRAME_SMALL_CHANGE;
+        }
+
+    } else {
+
+        difference = 0;
+        largest_difference = 0;
+
+    }
+
+    switch (change) {
+        case FRAME_STATIC:
+
+            // Keep comparing against the processed frame so that slow
+            // drift eventually triggers processing
+            static_frames++;
+            frames_since_full++;
+
+            break;
+        case FRAME_SMALL_CHANGE:
+
+            small_change_frames++;
+            frames_since_full++;
+            thumbnail.copyTo(reference_thumbnail);
+
+            break;
+        case FRAME_CHANGED:
+
+            changed_frames++;
+            frames_since_full = 0;
+            thumbnail.copyTo(reference_thumbnail);
+
+            break;
+    }
+
+    return change;
+}
+
+/**
+ * Get mean absolute difference of the last classified frame from its
+ * reference, in gray levels.
+ *
+ * @return
+ */
+double FrameChangeDetector::get_difference() {
+    return difference;
+}
+
+/**
+ * Get largest absolute difference of one thumbnail cell of the last
+ * classified frame from its reference, in gray levels.
+ *
+ * @return
+ */
+double FrameChangeDetector::get_largest_difference() {
+    return largest_difference;
+}
+
+/**
+ * Print statistics of skipped frames to the console.
+ */
+void FrameChangeDetector::print_statistics() {
+
+    if (total_frames == 0) {
+        return;
+    }
+
+    cout << "Frames: " << total_frames;
+    cout << " Skipped: " << static_frames << " (" << 100. * static_frames / total_frames << " %)";
+    cout << " Region only: " << small_change_frames << " (" << 100. * small_change_frames / total_frames << " %)";
+    cout << " Full: " << changed_frames << " (" << 100. * changed_frames / total_frames << " %)" << endl;
+
+}
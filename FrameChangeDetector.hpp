@@ -0,0 +1,77 @@
+/*
+ * File:   FrameChangeDetector.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef FRAMECHANGEDETECTOR_HPP
+#define FRAMECHANGEDETECTOR_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+// How much the frame changed since the last processed frame
+enum FrameChange {
+    FRAME_STATIC, // Reuse previous tracking result
+    FRAME_SMALL_CHANGE, // Mean difference is small, process only the region around the victim. No shift is estimated.
+    FRAME_CHANGED // Process the whole frame
+};
+
+/**
+ * Cheap change detector on a tiny grayscale thumbnail.
+ *
+ * The thumbnail of each frame is compared with the thumbnail of the last
+ * processed frame by mean absolute difference. Repeated frames from the
+ * capture device and frames taken while the boat holds station fall below
+ * the static threshold. A frame is static only if no single thumbnail cell
+ * changed either, so a victim moving in an otherwise still scene is never
+ * skipped.
+ */
+class FrameChangeDetector {
+public:
+
+    FrameChangeDetector(Settings&);
+    FrameChangeDetector(const FrameChangeDetector& orig) = delete;
+    FrameChangeDetector& operator=(const FrameChangeDetector& orig) = delete;
+    virtual ~FrameChangeDetector();
+
+    FrameChange classify(const Mat&, bool);
+
+    double get_difference();
+
+    double get_largest_difference();
+
+    void print_statistics();
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Thumbnail of the current frame
+    Mat thumbnail;
+
+    // Thumbnail of the last processed frame
+    Mat reference_thumbnail;
+
+    // Mean absolute difference of the current and reference thumbnail
+    double difference = 0;
+
+    // Largest absolute difference of one thumbnail cell
+    double largest_difference = 0;
+
+    // Frames since the last whole frame was processed
+    int frames_since_full = 0;
+
+    // Statistics
+    long total_frames = 0;
+    long static_frames = 0;
+    long small_change_frames = 0;
+    long changed_frames = 0;
+
+};
+
+#endif /* FRAMECHANGEDETECTOR_HPP */
+
@@ -0,0 +1,476 @@
+/*
+ * File:   FramePipeline.cpp
+ * Author: Jan Dufek
+ */
+
+#include "FramePipeline.hpp"
+#include "Tracer.hpp"
+#include <string.h>
+
+/**
+ * Runs the whole chain on blocks of bands.
+ */
+class ProcessBandsInvoker : public ParallelLoopBody {
+public:
+
+    ProcessBandsInvoker(FramePipeline& p, const Mat& f, const HueBackProjector& b, Mat& o) : pipeline(p), frame(f), back_projector(b), back_projection(o) {
+    }
+
+    virtual void operator()(const Range& range) const {
+        pipeline.process_bands(frame, back_projector, back_projection, range);
+    }
+
+private:
+
+    FramePipeline& pipeline;
+    const Mat& frame;
+    const HueBackProjector& back_projector;
+    Mat& back_projection;
+
+};
+
+FramePipeline::FramePipeline(Settings& s) {
+
+    settings = &s;
+
+    band_rows = 0;
+    band_count = 0;
+
+    // Identity equalization until the first frame is processed
+    for (int i = 0; i < 256; i++) {
+        equalization[i] = (uchar) i;
+    }
+
+    update_thresholds();
+
+}
+
+FramePipeline::~FramePipeline() {
+}
+
+/**
+ * Run the pipeline on the region of the frame.
+ *
+ * Back projection has the size of the frame and is zero outside of the
+ * region.
+ *
+ * @param frame frame in BGR
+ * @param region region of the frame to process
+ * @param back_projector back projection kernel of the current histogram
+ * @param back_projection output back projection
+ * @param refresh_equalization recompute value equalization from this region
+ * for the next frame, otherwise the equalization of the last refresh is kept
+ */
+void FramePipeline::process(const Mat& frame, const Rect& processed_region, const HueBackProjector& back_projector, Mat& back_projection, bool refresh_equalization) {
+
+    Rect frame_rectangle(0, 0, frame.cols, frame.rows);
+
+    region = processed_region & frame_rectangle;
+
+    back_projection.create(frame.size(), CV_8UC1);
+
+    // Nothing outside of the region projects
+    if (region != frame_rectangle) {
+        back_projection.setTo(Scalar::all(0));
+    }
+
+    if (retain_planes) {
+        hue.create(frame.size(), CV_8UC1);
+        saturation_value_threshold.create(frame.size(), CV_8UC1);
+    }
+
+    if (region.area() == 0) {
+        return;
+    }
+
+    layout_bands(frame);
+
+    // Direct BGR lookup needs the hue lookup table and no hue plane
+    bgr_lookup = settings->bgr_lookup_table && back_projector.get_lut() != NULL && !retain_planes;
+
+    if (bgr_lookup) {
+
+        // Cells of hues the adaptation moved are remapped, the saturation
+        // trackbars rebuild the table
+        color_table.update(back_projector.get_lut(), settings->saturation_min, settings->saturation_max, settings->lookup_table_bits, settings->lookup_table_tolerance);
+
+    }
+
+    // Thresholds use the equalization of the previous refresh
+    update_thresholds();
+
+    if (band_count > 1) {
+        parallel_for_(Range(0, band_count), ProcessBandsInvoker(*this, frame, back_projector, back_projection), band_count);
+    } else {
+        process_bands(frame, back_projector, back_projection, Range(0, band_count));
+    }
+
+    // Histograms of this pass equalize the next frame
+    if (refresh_equalization) {
+        update_equalization();
+    }
+}
+
+/**
+ * Build the BGR table for the histogram ahead of the first frame.
+ *
+ * @param back_projector back projection kernel of the histogram
+ */
+void FramePipeline::prepare(const HueBackProjector& back_projector) {
+
+    if (back_projector.get_lut() != NULL) {
+        color_table.update(back_projector.get_lut(), settings->saturation_min, settings->saturation_max, settings->lookup_table_bits);
+    }
+}
+
+/**
+ * Split the region into bands whose working set fits the cache budget.
+ *
+ * @param frame
+ */
+void FramePipeline::layout_bands(const Mat& frame) {
+
+    if (settings->tiled_pipeline) {
+
+        // Input, blurred and HSV pixels of one row of the band
+        int row_bytes = region.width * 3 * frame.elemSize1() * 3;
+
+        band_rows = settings->pipeline_band_bytes / max(row_bytes, 1);
+
+        // Bands much thinner than the blur kernel spend most time in halos
+        int minimum_band_rows = max(8, settings->blur_kernel_size);
+
+        // Give every thread at least one band
+        int threads = max(getNumThreads(), 1);
+        if ((region.height + band_rows - 1) / max(band_rows, 1) < threads) {
+            band_rows = (region.height + threads - 1) / threads;
+        }
+
+        band_rows = min(max(band_rows, minimum_band_rows), region.height);
+
+    } else {
+
+        // Whole region as one band
+        band_rows = region.height;
+
+    }
+
+    band_count = (region.height + band_rows - 1) / band_rows;
+
+    if ((int) blurred_bands.size() < band_count) {
+        blurred_bands.resize(band_count);
+        hsv_bands.resize(band_count);
+    }
+
+    band_value_histograms.resize(band_count * 256);
+}
+
+/**
+ * Compute value equalization table from the band histograms. This is the
+ * same mapping equalizeHist computes for the whole region.
+ */
+void FramePipeline::update_equalization() {
+
+    int value_histogram[256] = {0};
+
+    for (int band = 0; band < band_count; band++) {
+        for (int i = 0; i < 256; i++) {
+            value_histogram[i] += band_value_histograms[band * 256 + i];
+        }
+    }
+
+    int total = region.area();
+
+    int i = 0;
+    while (!value_histogram[i]) {
+        equalization[i++] = 0;
+    }
+
+    // Uniform region maps everything to its only value
+    if (value_histogram[i] == total) {
+        memset(equalization, i, sizeof (equalization));
+        return;
+    }
+
+    int denominator = total - value_histogram[i];
+    float scale = 255.f / denominator;
+    int sum = 0;
+
+    for (equalization[i++] = 0; i < 256; i++) {
+
+        sum += value_histogram[i];
+
+        if (settings->integer_tracking) {
+            // Rounded integer division, can differ by one at exact halves
+            equalization[i] = (uchar) (((int64) sum * 510 + denominator) / (2 * (int64) denominator));
+        } else {
+            equalization[i] = saturate_cast<uchar> (sum * scale);
+        }
+
+    }
+}
+
+/**
+ * Compute saturation and value threshold tables from current settings.
+ * Value is thresholded after equalization.
+ */
+void FramePipeline::update_thresholds() {
+
+    for (int i = 0; i < 256; i++) {
+
+        saturation_pass[i] = (i >= settings->saturation_min && i <= settings->saturation_max) ? 255 : 0;
+
+        value_pass[i] = (equalization[i] >= settings->value_min && equalization[i] <= settings->value_max) ? 255 : 0;
+
+    }
+}
+
+/**
+ * Blur the bands, convert them to HSV, threshold and back project them and
+ * collect value histograms for the next equalization.
+ *
+ * @param frame
+ * @param back_projector
+ * @param back_projection
+ * @param range range of bands
+ */
+void FramePipeline::process_bands(const Mat& frame, const HueBackProjector& back_projector, Mat& back_projection, const Range& range) {
+
+    const uchar * lut = back_projector.get_lut();
+
+    for (int band = range.start; band < range.end; band++) {
+
+        TraceScope trace("process_band");
+
+        int top = band * band_rows;
+        int height = min(band_rows, region.height - top);
+
+        Rect band_rectangle(region.x, region.y + top, region.width, height);
+
+        // The band view keeps its parent, so the blur reads halo rows from
+        // the neighbouring bands and uses the border only at the frame edge
+        Mat input_band = frame(band_rectangle);
+
+        GaussianBlur(input_band, blurred_bands[band], Size(settings->blur_kernel_size, settings->blur_kernel_size), 0, 0);
+
+        // Value histogram of the band
+        int * value_histogram = &band_value_histograms[band * 256];
+        memset(value_histogram, 0, 256 * sizeof (int));
+
+        // One lookup per pixel in the BGR table, value is the maximum of
+        // the channels and is thresholded separately
+        if (bgr_lookup) {
+
+            const uchar * table = color_table.get_table();
+            int bits = color_table.get_bits();
+
+            for (int y = 0; y < height; y++) {
+
+                const uchar * pixel = blurred_bands[band].ptr<uchar>(y);
+                uchar * output_row = back_projection.ptr<uchar>(region.y + top + y) + region.x;
+
+                for (int x = 0; x < region.width; x++, pixel += 3) {
+                    uchar value = max(pixel[0], max(pixel[1], pixel[2]));
+                    value_histogram[value]++;
+                    output_row[x] = table[ColorLookupTable::index(pixel, bits)] & value_pass[value];
+                }
+
+            }
+
+            continue;
+        }
+
+        Mat& hsv_band = hsv_bands[band];
+        cvtColor(blurred_bands[band], hsv_band, COLOR_BGR2HSV);
+
+        // Generic back projection needs the hue and threshold planes
+        if (!lut || retain_planes) {
+
+            Mat hue_band, mask_band;
+
+            if (retain_planes) {
+                hue_band = hue(band_rectangle);
+                mask_band = saturation_value_threshold(band_rectangle);
+            } else {
+                hue_band.create(height, region.width, CV_8UC1);
+                mask_band.create(height, region.width, CV_8UC1);
+            }
+
+            for (int y = 0; y < height; y++) {
+
+                const uchar * pixel = hsv_band.ptr<uchar>(y);
+                uchar * hue_row = hue_band.ptr<uchar>(y);
+                uchar * mask_row = mask_band.ptr<uchar>(y);
+
+                for (int x = 0; x < region.width; x++) {
+                    value_histogram[pixel[3 * x + 2]]++;
+                    hue_row[x] = pixel[3 * x];
+                    mask_row[x] = saturation_pass[pixel[3 * x + 1]] & value_pass[pixel[3 * x + 2]];
+                }
+
+            }
+
+            Mat back_projection_band = back_projection(band_rectangle);
+            back_projector.project(hue_band, mask_band, back_projection_band);
+
+            continue;
+        }
+
+        // Fused threshold and back projection
+        for (int y = 0; y < height; y++) {
+
+            const uchar * pixel = hsv_band.ptr<uchar>(y);
+            uchar * output_row = back_projection.ptr<uchar>(region.y + top + y) + region.x;
+
+            for (int x = 0; x < region.width; x++) {
+                value_histogram[pixel[3 * x + 2]]++;
+                output_row[x] = lut[pixel[3 * x]] & saturation_pass[pixel[3 * x + 1]] & value_pass[pixel[3 * x + 2]];
+            }
+
+        }
+
+    }
+}
+
+/**
+ * Measure pipeline time on the frame for 1 to N threads and print the
+ * speedup to the console.
+ *
+ * @param frame
+ * @param back_projector
+ */
+void FramePipeline::report_scaling(const Mat& frame, const HueBackProjector& back_projector) {
+
+    // Number of timed runs for each thread count
+    const int repetitions = 10;
+
+    int original_threads = getNumThreads();
+    int cpus = getNumberOfCPUs();
+
+    Rect frame_rectangle(0, 0, frame.cols, frame.rows);
+    Mat output;
+
+    double single_thread_time = 0;
+
+    cout << "Pipeline scaling on " << frame.cols << "x" << frame.rows << ":" << endl;
+
+    for (int threads = 1; threads <= cpus; threads++) {
+
+        setNumThreads(threads);
+
+        // Warm up buffers
+        process(frame, frame_rectangle, back_projector, output);
+
+        int64 start = getTickCount();
+
+        for (int i = 0; i < repetitions; i++) {
+            process(frame, frame_rectangle, back_projector, output);
+        }
+
+        double time = (getTickCount() - start) * 1000. / getTickFrequency() / repetitions;
+
+        if (threads == 1) {
+            single_thread_time = time;
+        }
+
+        cout << "Threads: " << threads << " Bands: " << band_count << " Time: " << time << " ms Speedup: " << single_thread_time / time << endl;
+
+    }
+
+    setNumThreads(original_threads);
+}
+
+/**
+ * Keep hue and threshold planes of the processed region. They are needed
+ * to create a histogram from a selection.
+ *
+ * @param retain
+ */
+void FramePipeline::set_retain_planes(bool retain) {
+    retain_planes = retain;
+}
+
+/**
+ * Get hue plane. Only valid if planes are retained.
+ *
+ * @return
+ */
+Mat& FramePipeline::get_hue() {
+    return hue;
+}
+
+/**
+ * Get saturation value threshold. Only valid if planes are retained.
+ *
+ * @return
+ */
+Mat& FramePipeline::get_saturation_value_threshold() {
+    return saturation_value_threshold;
+}
+
+/**
+ * Hue histogram of pixels which pass the saturation and value threshold,
+ * read from the HSV bands of the last processed region. In BGR lookup mode
+ * only the rectangle is converted to HSV.
+ *
+ * @param roi rectangle in frame coordinates, clipped to the last region
+ * @param histogram_size
+ * @param ranges hue range of the histogram
+ * @param histogram output histogram of counts, histogram_size x 1 float
+ * @return number of counted pixels
+ */
+int FramePipeline::hue_histogram(const Rect& roi, int histogram_size, const float* ranges, Mat& histogram) const {
+
+    histogram = Mat::zeros(histogram_size, 1, CV_32FC1);
+
+    Rect clipped = roi & region;
+
+    int range_min = cvRound(ranges[0]);
+    int range_max = cvRound(ranges[1]);
+
+    float * bins = histogram.ptr<float>();
+    int pixels = 0;
+
+    if (clipped.area() == 0) {
+        return 0;
+    }
+
+    // The rectangle is gathered from the bands. Without HSV bands it is
+    // converted from the blurred bands.
+    Mat roi_hsv(clipped.size(), CV_8UC3);
+
+    for (int band = (clipped.y - region.y) / band_rows; band < band_count && band * band_rows < clipped.br().y - region.y; band++) {
+
+        int top = max(band * band_rows, clipped.y - region.y);
+        int bottom = min((band + 1) * band_rows, clipped.br().y - region.y);
+
+        Rect band_rows_rectangle(clipped.x - region.x, top - band * band_rows, clipped.width, bottom - top);
+        Mat hsv_rows = roi_hsv(Rect(0, top - (clipped.y - region.y), clipped.width, bottom - top));
+
+        if (bgr_lookup) {
+            cvtColor(blurred_bands[band](band_rows_rectangle), hsv_rows, COLOR_BGR2HSV);
+        } else {
+            hsv_bands[band](band_rows_rectangle).copyTo(hsv_rows);
+        }
+    }
+
+    for (int y = 0; y < clipped.height; y++) {
+
+        const uchar * pixel = roi_hsv.ptr<uchar>(y);
+
+        for (int x = 0; x < clipped.width; x++, pixel += 3) {
+
+            int hue_value = pixel[0];
+
+            if (hue_value < range_min || hue_value >= range_max || !(saturation_pass[pixel[1]] & value_pass[pixel[2]])) {
+                continue;
+            }
+
+            bins[(hue_value - range_min) * histogram_size / (range_max - range_min)]++;
+            pixels++;
+        }
+
+    }
+
+    return pixels;
+}
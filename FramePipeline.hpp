@@ -0,0 +1,110 @@
+/*
+ * File:   FramePipeline.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef FRAMEPIPELINE_HPP
+#define FRAMEPIPELINE_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "HueBackProjector.hpp"
+#include "ColorLookupTable.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Per-frame image pipeline: Gaussian blur, HSV conversion, equalization of
+ * value, saturation and value threshold and hue back projection.
+ *
+ * With bgr_lookup_table set, the HSV conversion is skipped and blurred BGR
+ * pixels are projected through a ColorLookupTable instead.
+ *
+ * The frame is split into horizontal bands which are processed on the
+ * OpenCV thread pool. Each band runs the whole chain while its
+ * intermediates are still in cache. Blur halos are read from the
+ * neighbouring rows of the input frame.
+ *
+ * Each band is read once: it is blurred, converted to HSV, thresholded and
+ * back projected through lookup tables. Equalization needs the value
+ * histogram of the whole region, so the bands use the equalization of the
+ * last refresh and collect value histograms on the side. The equalization
+ * of a refresh applies from the next frame, which is one frame of lag on a
+ * slowly changing scene.
+ */
+class FramePipeline {
+public:
+
+    FramePipeline(Settings&);
+    FramePipeline(const FramePipeline& orig) = delete;
+    FramePipeline& operator=(const FramePipeline& orig) = delete;
+    virtual ~FramePipeline();
+
+    void process(const Mat&, const Rect&, const HueBackProjector&, Mat&, bool = true);
+
+    void prepare(const HueBackProjector&);
+
+    void report_scaling(const Mat&, const HueBackProjector&);
+
+    void set_retain_planes(bool);
+
+    Mat& get_hue();
+
+    Mat& get_saturation_value_threshold();
+
+    int hue_histogram(const Rect&, int, const float*, Mat&) const;
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Region currently being processed
+    Rect region;
+
+    // Band layout of the region
+    int band_rows;
+    int band_count;
+
+    // Blurred and HSV band scratch buffers, one per band
+    vector<Mat> blurred_bands;
+    vector<Mat> hsv_bands;
+
+    // Value histograms of the bands
+    vector<int> band_value_histograms;
+
+    // Value equalization lookup table of the last full update
+    uchar equalization[256];
+
+    // Saturation and value threshold lookup tables
+    uchar saturation_pass[256];
+    uchar value_pass[256];
+
+    // Whether hue and threshold planes are kept for histogram creation
+    bool retain_planes = false;
+
+    // Quantized BGR to probability table
+    ColorLookupTable color_table;
+
+    // Current region is projected through the BGR table, without HSV
+    bool bgr_lookup = false;
+
+    // Hue and saturation value threshold of the region
+    Mat hue;
+    Mat saturation_value_threshold;
+
+    void layout_bands(const Mat&);
+
+    void update_equalization();
+
+    void update_thresholds();
+
+    void process_bands(const Mat&, const HueBackProjector&, Mat&, const Range&);
+
+    friend class ProcessBandsInvoker;
+
+};
+
+#endif /* FRAMEPIPELINE_HPP */
+
@@ -0,0 +1,80 @@
+/*
+ * File:   FrameServer.cpp
+ * Author: Jan Dufek
+ */
+
+#include "FrameServer.hpp"
+#include "ThreadPlacement.hpp"
+
+FrameServer::FrameServer(Settings& s) {
+
+    settings = &s;
+
+    ring = new SharedFrameRing();
+
+}
+
+FrameServer::~FrameServer() {
+
+    // Unlink shared memory
+    delete ring;
+
+}
+
+/**
+ * Decode frames until the source ends. Dropped streams are reopened and
+ * consumers keep waiting on the ring meanwhile.
+ *
+ * @return 0 when the source ended, -1 if it could not be opened
+ */
+int FrameServer::run() {
+
+    ThreadPlacement thread_placement(* settings);
+    thread_placement.apply(THREAD_CAPTURE);
+
+    StreamSupervisor stream_supervisor(* settings);
+
+    stream_supervisor.open(settings->video_capture_source);
+
+    // Decode the first frame to learn the real frame format
+    Mat frame;
+    while (!stream_supervisor.read(frame) && !stream_supervisor.has_ended()) {
+    }
+
+    if (frame.empty()) {
+        cout << "No frames in " << settings->video_capture_source << endl;
+        return -1;
+    }
+
+    if (!ring->create(settings->shared_frames_name, frame.size(), frame.type(), settings->shared_frames_slots, stream_supervisor.get(CV_CAP_PROP_FPS))) {
+        return -1;
+    }
+
+    ring->publish(frame);
+
+    cout << "Serving " << frame.cols << "x" << frame.rows << " frames as " << settings->shared_frames_name << endl;
+
+    while (!stream_supervisor.has_ended()) {
+
+        // Decode directly into the next slot when the decoder allows it
+        Mat slot = ring->begin_write();
+        frame = slot;
+
+        if (!stream_supervisor.read(frame)) {
+
+            // Nothing is published and the slot is reused for the next frame
+            ring->cancel_write();
+
+            continue;
+        }
+
+        // Frames of a stream reconnected in another resolution are resized
+        // into the slot
+        ring->end_write(frame);
+
+    }
+
+    stream_supervisor.print_statistics();
+
+    return 0;
+}
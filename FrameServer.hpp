@@ -0,0 +1,40 @@
+/*
+ * File:   FrameServer.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef FRAMESERVER_HPP
+#define FRAMESERVER_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "SharedFrameRing.hpp"
+#include "StreamSupervisor.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Decodes the video source once and publishes frames into shared memory
+ * for the tracker, the recorder and any other consumer process.
+ */
+class FrameServer {
+public:
+
+    FrameServer(Settings&);
+    FrameServer(const FrameServer& orig) = delete;
+    FrameServer& operator=(const FrameServer& orig) = delete;
+    virtual ~FrameServer();
+
+    int run();
+
+private:
+
+    Settings * settings;
+
+    SharedFrameRing * ring;
+
+};
+
+#endif /* FRAMESERVER_HPP */
+
@@ -0,0 +1,171 @@
+/*
+ * File:   HorizonDetector.cpp
+ * Author: Jan Dufek
+ */
+
+#include "HorizonDetector.hpp"
+
+// Candidates farther from the fitted line in thumbnail pixels disagree with it
+static const double INLIER_DISTANCE = 1.5;
+
+HorizonDetector::HorizonDetector(Settings& s) {
+    settings = &s;
+}
+
+HorizonDetector::~HorizonDetector() {
+}
+
+/**
+ * Estimate the horizon if the last estimate is old enough.
+ *
+ * @param frame BGR frame
+ * @return whether a horizon is known
+ */
+bool HorizonDetector::update(const Mat& frame) {
+
+    if (frames_since_estimate == 0) {
+        estimate(frame);
+    }
+
+    frames_since_estimate = (frames_since_estimate + 1) % max(settings->horizon_interval, 1);
+
+    return found;
+}
+
+/**
+ * Fit the horizon line to the strongest horizontal edges.
+ *
+ * @param frame BGR frame
+ */
+void HorizonDetector::estimate(const Mat& frame) {
+
+    estimates++;
+    found = false;
+
+    // Area interpolation removes most of the wave texture
+    int width = max(settings->horizon_thumbnail_width, 16);
+    int height = max(width * frame.rows / max(frame.cols, 1), 8);
+
+    Mat small;
+    resize(frame, small, Size(width, height), 0, 0, INTER_AREA);
+    cvtColor(small, thumbnail, COLOR_BGR2GRAY);
+
+    Sobel(thumbnail, gradient, CV_16S, 0, 1, 3);
+
+    // Border rows are gradients of the replicated border, so they are skipped
+    candidates.clear();
+    for (int x = 0; x < width; x++) {
+
+        int strongest = 0;
+        int strongest_row = -1;
+
+        for (int y = 1; y < height - 1; y++) {
+            int strength = abs(gradient.at<short>(y, x));
+            if (strength > strongest) {
+                strongest = strength;
+                strongest_row = y;
+            }
+        }
+
+        if (strongest >= settings->horizon_min_gradient) {
+            candidates.push_back(Point2f(x, strongest_row + 0.5f));
+        }
+    }
+
+    int min_inliers = cvCeil(settings->horizon_min_inliers * width);
+
+    if ((int) candidates.size() < max(min_inliers, 2)) {
+        return;
+    }
+
+    // Huber distance keeps candidates on glint from pulling the line
+    Vec4f line;
+    fitLine(candidates, line, DIST_HUBER, 0, 0.01, 0.01);
+
+    if (fabs(line[0]) < 1e-6) {
+        return;
+    }
+
+    double slope = line[1] / line[0];
+
+    if (fabs(atan(slope)) * 180 / CV_PI > settings->horizon_max_tilt) {
+        return;
+    }
+
+    int inliers = 0;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        double row = line[3] + slope * (candidates[i].x - line[2]);
+        if (fabs(candidates[i].y - row) <= INLIER_DISTANCE) {
+            inliers++;
+        }
+    }
+
+    if (inliers < min_inliers) {
+        return;
+    }
+
+    left = (line[3] + slope * (0 - line[2])) / height;
+    right = (line[3] + slope * (width - line[2])) / height;
+    found = true;
+
+    found_estimates++;
+    skipped_rows += get_water_top(height) / (double) height;
+}
+
+/**
+ * Check whether the last estimate was accepted.
+ *
+ * @return
+ */
+bool HorizonDetector::is_found() {
+    return found;
+}
+
+/**
+ * Get the first row to process, the higher end of the horizon minus the
+ * margin.
+ *
+ * @param rows height of the frame
+ * @return 0 if no horizon is known
+ */
+int HorizonDetector::get_water_top(int rows) {
+
+    if (!found) {
+        return 0;
+    }
+
+    double top = min(left, right) - settings->horizon_margin;
+
+    return min(max(cvFloor(top * rows), 0), max(rows - 1, 0));
+}
+
+/**
+ * Get the last horizon line.
+ *
+ * @param left_row horizon row at the left edge as a fraction of frame height
+ * @param right_row horizon row at the right edge as a fraction of frame height
+ */
+void HorizonDetector::get_horizon(double& left_row, double& right_row) {
+    left_row = left;
+    right_row = right;
+}
+
+/**
+ * Print how often the horizon was found and how many rows it saved.
+ */
+void HorizonDetector::print_statistics() {
+
+    if (estimates == 0) {
+        return;
+    }
+
+    cout << "Horizon estimates: " << estimates;
+    cout << " Found: " << found_estimates << " (" << 100. * found_estimates / estimates << " %)";
+
+    if (found_estimates > 0) {
+        cout << " Rows skipped: " << 100. * skipped_rows / found_estimates << " %";
+    }
+
+    cout << endl;
+
+}
@@ -0,0 +1,80 @@
+/*
+ * File:   HorizonDetector.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef HORIZONDETECTOR_HPP
+#define HORIZONDETECTOR_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Horizon estimator on a small grayscale thumbnail.
+ *
+ * The strongest horizontal edge of every thumbnail column is a horizon
+ * candidate. A robust line is fitted through the candidates and accepted
+ * if it is not tilted too much and enough columns agree with it. Waves
+ * give strong edges too, but they do not line up across the frame.
+ *
+ * Victims are always in the water, so rows above the horizon are not
+ * processed. The estimate is refreshed every few frames, which is enough
+ * for the roll of the boat between two estimates to stay inside of the
+ * margin. Without an accepted horizon the whole frame is processed.
+ */
+class HorizonDetector {
+public:
+
+    HorizonDetector(Settings&);
+    HorizonDetector(const HorizonDetector& orig) = delete;
+    HorizonDetector& operator=(const HorizonDetector& orig) = delete;
+    virtual ~HorizonDetector();
+
+    bool update(const Mat&);
+
+    bool is_found();
+
+    int get_water_top(int);
+
+    void get_horizon(double&, double&);
+
+    void print_statistics();
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Grayscale thumbnail of the last estimated frame
+    Mat thumbnail;
+
+    // Vertical gradient of the thumbnail
+    Mat gradient;
+
+    // Strongest horizontal edge of each column
+    vector<Point2f> candidates;
+
+    // Horizon row at the left and right edge as a fraction of frame height
+    double left = 0;
+    double right = 0;
+
+    // The last estimate was accepted
+    bool found = false;
+
+    // Frames since the last estimate
+    int frames_since_estimate = 0;
+
+    // Statistics
+    long estimates = 0;
+    long found_estimates = 0;
+    double skipped_rows = 0;
+
+    void estimate(const Mat&);
+
+};
+
+#endif /* HORIZONDETECTOR_HPP */
+
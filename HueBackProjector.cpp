@@ -0,0 +1,130 @@
+/*
+ * File:   HueBackProjector.cpp
+ * Author: Jan Dufek
+ */
+
+#include "HueBackProjector.hpp"
+#include "BuildProfile.hpp"
+#include <string.h>
+
+HueBackProjector::HueBackProjector() {
+
+    build_function = 0;
+    project_function = 0;
+
+    memset(lut, 0, sizeof (lut));
+
+    histogram_ranges[0] = 0;
+    histogram_ranges[1] = 180;
+
+}
+
+HueBackProjector::~HueBackProjector() {
+}
+
+/**
+ * Set histogram to back project and select the kernel for its bin count.
+ *
+ * @param new_histogram histogram normalized to 0-255
+ * @param histogram_size number of bins
+ * @param ranges hue range of the histogram
+ */
+void HueBackProjector::set_histogram(const Mat& new_histogram, int histogram_size, const float* ranges) {
+
+    new_histogram.copyTo(histogram);
+
+    histogram_ranges[0] = ranges[0];
+    histogram_ranges[1] = ranges[1];
+
+    build_function = 0;
+    project_function = 0;
+
+    // Only the full OpenCV hue range has specialized kernels
+    if (ranges[0] == 0 && ranges[1] == 180 && histogram.type() == CV_32FC1 && (int) histogram.total() == histogram_size) {
+
+#ifdef PROFILE_HISTOGRAM_SIZE
+
+        // Only the kernel of the build profile is compiled
+        if (histogram_size == PROFILE_HISTOGRAM_SIZE) {
+            build_function = &FixedHueBackProjector<PROFILE_HISTOGRAM_SIZE, 0, 180>::build;
+            project_function = &FixedHueBackProjector<PROFILE_HISTOGRAM_SIZE, 0, 180>::project;
+        }
+
+#else
+
+        switch (histogram_size) {
+            case 8:
+                build_function = &FixedHueBackProjector<8, 0, 180>::build;
+                project_function = &FixedHueBackProjector<8, 0, 180>::project;
+                break;
+            case 12:
+                build_function = &FixedHueBackProjector<12, 0, 180>::build;
+                project_function = &FixedHueBackProjector<12, 0, 180>::project;
+                break;
+            case 16:
+                build_function = &FixedHueBackProjector<16, 0, 180>::build;
+                project_function = &FixedHueBackProjector<16, 0, 180>::project;
+                break;
+            case 32:
+                build_function = &FixedHueBackProjector<32, 0, 180>::build;
+                project_function = &FixedHueBackProjector<32, 0, 180>::project;
+                break;
+            case 64:
+                build_function = &FixedHueBackProjector<64, 0, 180>::build;
+                project_function = &FixedHueBackProjector<64, 0, 180>::project;
+                break;
+            case 180:
+                build_function = &FixedHueBackProjector<180, 0, 180>::build;
+                project_function = &FixedHueBackProjector<180, 0, 180>::project;
+                break;
+        }
+
+#endif
+
+    }
+
+    if (build_function) {
+        build_function(histogram, lut);
+    }
+}
+
+/**
+ * Back project hue and apply saturation value mask.
+ *
+ * @param hue hue plane
+ * @param mask saturation value threshold
+ * @param back_projection output
+ */
+void HueBackProjector::project(const Mat& hue, const Mat& mask, Mat& back_projection) const {
+
+    if (project_function) {
+
+        project_function(lut, hue, mask, back_projection);
+
+    } else {
+
+        // Generic path for histograms without a specialized kernel
+        const float * pointer_histogram_ranges = histogram_ranges;
+        calcBackProject(&hue, 1, 0, histogram, back_projection, &pointer_histogram_ranges);
+        back_projection &= mask;
+
+    }
+}
+
+/**
+ * Check whether the current histogram uses a specialized kernel.
+ *
+ * @return
+ */
+bool HueBackProjector::is_specialized() const {
+    return project_function != 0;
+}
+
+/**
+ * Get hue to probability lookup table of the specialized kernel.
+ *
+ * @return lookup table, or null if the generic path is used
+ */
+const uchar * HueBackProjector::get_lut() const {
+    return project_function ? lut : 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * File:   HueBackProjector.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef HUEBACKPROJECTOR_HPP
+#define HUEBACKPROJECTOR_HPP
+
+#include "opencv2/opencv.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Back projection kernel for a one-dimensional hue histogram with the bin
+ * count and hue range fixed at compile time.
+ *
+ * Hue is an 8-bit value, so the whole hue-to-bin-to-probability mapping
+ * collapses into a 256-entry byte lookup table. The saturation and value
+ * mask is applied in the same pass, so the kernel reads hue and mask once
+ * and writes the back projection once.
+ */
+template<int BINS, int RANGE_MIN, int RANGE_MAX>
+class FixedHueBackProjector {
+public:
+
+    static_assert(BINS > 0, "Histogram must have at least one bin");
+    static_assert(RANGE_MAX > RANGE_MIN, "Histogram range must not be empty");
+
+    /**
+     * Build the lookup table from a histogram with BINS bins normalized to
+     * 0-255.
+     *
+     * @param histogram
+     * @param lut
+     */
+    static void build(const Mat& histogram, uchar * lut) {
+
+        const float * bins = histogram.ptr<float>();
+
+        for (int hue = 0; hue < 256; hue++) {
+
+            // Hue values outside of the histogram range do not project
+            if (hue < RANGE_MIN || hue >= RANGE_MAX) {
+                lut[hue] = 0;
+            } else {
+                lut[hue] = saturate_cast<uchar> (bins[(hue - RANGE_MIN) * BINS / (RANGE_MAX - RANGE_MIN)]);
+            }
+
+        }
+    }
+
+    /**
+     * Back project hue through the lookup table and apply the mask.
+     *
+     * @param lut
+     * @param hue
+     * @param mask
+     * @param back_projection
+     */
+    static void project(const uchar * lut, const Mat& hue, const Mat& mask, Mat& back_projection) {
+
+        back_projection.create(hue.size(), CV_8UC1);
+
+        int rows = hue.rows;
+        int cols = hue.cols;
+
+        // Process continuous matrices as one long row
+        if (hue.isContinuous() && mask.isContinuous() && back_projection.isContinuous()) {
+            cols *= rows;
+            rows = 1;
+        }
+
+        for (int y = 0; y < rows; y++) {
+
+            const uchar * hue_row = hue.ptr<uchar>(y);
+            const uchar * mask_row = mask.ptr<uchar>(y);
+            uchar * output_row = back_projection.ptr<uchar>(y);
+
+            int x = 0;
+
+            // Unrolled by four so the loads of the next lookups are independent
+            for (; x <= cols - 4; x += 4) {
+                output_row[x] = lut[hue_row[x]] & mask_row[x];
+                output_row[x + 1] = lut[hue_row[x + 1]] & mask_row[x + 1];
+                output_row[x + 2] = lut[hue_row[x + 2]] & mask_row[x + 2];
+                output_row[x + 3] = lut[hue_row[x + 3]] & mask_row[x + 3];
+            }
+
+            for (; x < cols; x++) {
+                output_row[x] = lut[hue_row[x]] & mask_row[x];
+            }
+
+        }
+    }
+
+};
+
+/**
+ * Back projection of the hue histogram used by the tracker.
+ *
+ * Common bin counts over the OpenCV hue range 0-180 are dispatched to
+ * FixedHueBackProjector instantiations. Any other histogram falls back to
+ * calcBackProject.
+ */
+class HueBackProjector {
+public:
+
+    HueBackProjector();
+    HueBackProjector(const HueBackProjector& orig) = delete;
+    HueBackProjector& operator=(const HueBackProjector& orig) = delete;
+    virtual ~HueBackProjector();
+
+    void set_histogram(const Mat&, int, const float*);
+
+    void project(const Mat&, const Mat&, Mat&) const;
+
+    bool is_specialized() const;
+
+    const uchar * get_lut() const;
+
+private:
+
+    typedef void (*BuildFunction)(const Mat&, uchar*);
+    typedef void (*ProjectFunction)(const uchar*, const Mat&, const Mat&, Mat&);
+
+    // Specialized kernel, or null if the generic path is used
+    BuildFunction build_function;
+    ProjectFunction project_function;
+
+    // Hue to probability lookup table
+    uchar lut[256];
+
+    // Histogram and ranges kept for the generic path
+    Mat histogram;
+    float histogram_ranges[2];
+
+};
+
+#endif /* HUEBACKPROJECTOR_HPP */
+
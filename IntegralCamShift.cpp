@@ -0,0 +1,532 @@
+/*
+ * File:   IntegralCamShift.cpp
+ * Author: Jan Dufek
+ */
+
+#include "IntegralCamShift.hpp"
+#include "FixedPoint.hpp"
+
+/**
+ * Compute a * b / m without overflow of a * b. All values non-negative and
+ * a, b not much larger than m times the window size.
+ *
+ * @param a
+ * @param b
+ * @param m
+ * @return
+ */
+static int64 product_over(int64 a, int64 b, int64 m) {
+
+    int64 quotient_a = a / m, remainder_a = a % m;
+    int64 quotient_b = b / m, remainder_b = b % m;
+
+    return quotient_a * b + quotient_b * remainder_a + remainder_a * remainder_b / m;
+}
+
+IntegralCamShift::IntegralCamShift() {
+    stride = 0;
+}
+
+IntegralCamShift::~IntegralCamShift() {
+}
+
+/**
+ * Build integral images of the back projection over the region. Windows
+ * are kept inside of the region.
+ *
+ * @param back_projection 8-bit back projection
+ * @param integral_region region of the back projection to cover
+ */
+void IntegralCamShift::set_image(const Mat& back_projection, const Rect& integral_region) {
+
+    CV_Assert(back_projection.type() == CV_8UC1);
+
+    image = back_projection;
+    region = integral_region & Rect(0, 0, back_projection.cols, back_projection.rows);
+
+    stride = region.width + 1;
+
+    size_t size = (size_t) stride * (region.height + 1);
+    sum.assign(size, 0);
+    sum_x.assign(size, 0);
+    sum_y.assign(size, 0);
+
+    for (int y = 0; y < region.height; y++) {
+
+        const uchar * pixel = back_projection.ptr<uchar>(region.y + y) + region.x;
+
+        const int64 * previous_sum = &sum[(size_t) y * stride];
+        const int64 * previous_sum_x = &sum_x[(size_t) y * stride];
+        const int64 * previous_sum_y = &sum_y[(size_t) y * stride];
+
+        int64 * current_sum = &sum[(size_t) (y + 1) * stride];
+        int64 * current_sum_x = &sum_x[(size_t) (y + 1) * stride];
+        int64 * current_sum_y = &sum_y[(size_t) (y + 1) * stride];
+
+        int64 row_sum = 0;
+        int64 row_sum_x = 0;
+
+        for (int x = 0; x < region.width; x++) {
+
+            row_sum += pixel[x];
+            row_sum_x += (int64) pixel[x] * x;
+
+            current_sum[x + 1] = previous_sum[x + 1] + row_sum;
+            current_sum_x[x + 1] = previous_sum_x[x + 1] + row_sum_x;
+
+            // Every pixel of the row prefix has the same y
+            current_sum_y[x + 1] = previous_sum_y[x + 1] + row_sum * y;
+
+        }
+
+    }
+}
+
+/**
+ * Zeroth and first moments of a window in region coordinates.
+ *
+ * @param window window inside of the region, in image coordinates
+ * @param m00
+ * @param m10
+ * @param m01
+ */
+void IntegralCamShift::moments(const Rect& window, int64& m00, int64& m10, int64& m01) const {
+
+    size_t top = (size_t) (window.y - region.y) * stride;
+    size_t bottom = (size_t) (window.y - region.y + window.height) * stride;
+    size_t left = window.x - region.x;
+    size_t right = left + window.width;
+
+    m00 = sum[bottom + right] - sum[bottom + left] - sum[top + right] + sum[top + left];
+    m10 = sum_x[bottom + right] - sum_x[bottom + left] - sum_x[top + right] + sum_x[top + left];
+    m01 = sum_y[bottom + right] - sum_y[bottom + left] - sum_y[top + right] + sum_y[top + left];
+}
+
+/**
+ * Sum of back projection in the window.
+ *
+ * @param window
+ * @return
+ */
+int64 IntegralCamShift::mass(const Rect& window) const {
+
+    Rect clipped = window & region;
+
+    if (clipped.area() == 0) {
+        return 0;
+    }
+
+    int64 m00, m10, m01;
+    moments(clipped, m00, m10, m01);
+
+    return m00;
+}
+
+/**
+ * Sums of back projection in many windows given as arrays of edges. The
+ * loop has no branches, so lookups of consecutive windows vectorize as
+ * gathers.
+ *
+ * @param left left edges, clamped to the region by the caller
+ * @param top top edges, clamped to the region by the caller
+ * @param right right edges, clamped to the region by the caller
+ * @param bottom bottom edges, clamped to the region by the caller
+ * @param count number of windows
+ * @param window_masses output, one per window
+ */
+void IntegralCamShift::masses(const int * left, const int * top, const int * right, const int * bottom, int count, int64 * window_masses) const {
+
+    const int64 * integral = sum.data();
+
+    for (int i = 0; i < count; i++) {
+
+        size_t top_row = (size_t) (top[i] - region.y) * stride;
+        size_t bottom_row = (size_t) (bottom[i] - region.y) * stride;
+        size_t left_column = left[i] - region.x;
+        size_t right_column = right[i] - region.x;
+
+        window_masses[i] = integral[bottom_row + right_column] - integral[bottom_row + left_column] - integral[top_row + right_column] + integral[top_row + left_column];
+    }
+}
+
+/**
+ * Region covered by the integral images.
+ *
+ * @return
+ */
+Rect IntegralCamShift::get_region() const {
+    return region;
+}
+
+/**
+ * Mean shift with the same stopping rules as cv::meanShift.
+ *
+ * @param window initial window, replaced by the final window
+ * @param criteria
+ * @param converged set if stopped by the epsilon criterion
+ * @return number of iterations
+ */
+int IntegralCamShift::mean_shift(Rect& window, const TermCriteria& criteria, bool& converged) const {
+
+    int iterations = (criteria.type & TermCriteria::COUNT) ? max(criteria.maxCount, 1) : 100;
+    double epsilon = (criteria.type & TermCriteria::EPS) ? max(criteria.epsilon, 0.) : 0.;
+    epsilon = cvRound(epsilon * epsilon);
+
+    converged = false;
+
+    if (region.area() == 0) {
+        return 0;
+    }
+
+    Rect current = window;
+
+    int i;
+    for (i = 0; i < iterations; i++) {
+
+        current &= region;
+
+        // Window left the region, restart it in the middle
+        if (current == Rect()) {
+            current.x = region.x + region.width / 2;
+            current.y = region.y + region.height / 2;
+        }
+
+        current.width = max(current.width, 1);
+        current.height = max(current.height, 1);
+
+        int64 m00, m10, m01;
+        moments(current, m00, m10, m01);
+
+        if (m00 == 0) {
+            break;
+        }
+
+        // Shift of centroid from the window center
+        int dx, dy;
+
+        if (integer_arithmetic) {
+            dx = (int) FixedPoint::divide_round(2 * m10 - (2 * (int64) (current.x - region.x) + current.width) * m00, 2 * m00);
+            dy = (int) FixedPoint::divide_round(2 * m01 - (2 * (int64) (current.y - region.y) + current.height) * m00, 2 * m00);
+        } else {
+            dx = cvRound((double) m10 / m00 - (current.x - region.x) - current.width * 0.5);
+            dy = cvRound((double) m01 / m00 - (current.y - region.y) - current.height * 0.5);
+        }
+
+        int nx = min(max(current.x + dx, region.x), region.x + region.width - current.width);
+        int ny = min(max(current.y + dy, region.y), region.y + region.height - current.height);
+
+        dx = nx - current.x;
+        dy = ny - current.y;
+
+        current.x = nx;
+        current.y = ny;
+
+        if (dx * dx + dy * dy < epsilon) {
+            converged = true;
+            i++;
+            break;
+        }
+
+    }
+
+    window = current;
+
+    return i;
+}
+
+/**
+ * Size and orientation of the object from second order moments of the
+ * final window. Follows cv::CamShift including its window update.
+ *
+ * @param window final mean shift window, replaced by the next search window
+ * @param result
+ */
+void IntegralCamShift::estimate_box(Rect& window, CamShiftResult& result) const {
+
+    // Window is enlarged by this many pixels before estimating the size
+    const int TOLERANCE = 10;
+
+    Rect inflated(window.x - TOLERANCE, window.y - TOLERANCE, window.width + 2 * TOLERANCE, window.height + 2 * TOLERANCE);
+    inflated &= region;
+
+    int64 m00, m10, m01;
+    moments(inflated, m00, m10, m01);
+
+    result.mass = (double) m00;
+
+    if (m00 == 0) {
+        result.box = RotatedRect();
+        return;
+    }
+
+    if (integer_arithmetic) {
+        estimate_box_integer(inflated, m00, m10, m01, window, result);
+        return;
+    }
+
+    // Centroid relative to the inflated window
+    double inverse_m00 = 1. / m00;
+    double centroid_x = m10 * inverse_m00 - (inflated.x - region.x);
+    double centroid_y = m01 * inverse_m00 - (inflated.y - region.y);
+
+    // Central second order moments over the inflated window
+    double mu20 = 0, mu02 = 0, mu11 = 0;
+
+    for (int y = 0; y < inflated.height; y++) {
+
+        const uchar * pixel = image.ptr<uchar>(inflated.y + y) + inflated.x;
+        double dy = y - centroid_y;
+
+        double row_xx = 0, row_x = 0, row_sum = 0;
+
+        for (int x = 0; x < inflated.width; x++) {
+            double weight = pixel[x];
+            double dx = x - centroid_x;
+            row_sum += weight;
+            row_x += weight * dx;
+            row_xx += weight * dx * dx;
+        }
+
+        mu20 += row_xx;
+        mu11 += row_x * dy;
+        mu02 += row_sum * dy * dy;
+
+    }
+
+    int xc = cvRound(centroid_x + inflated.x);
+    int yc = cvRound(centroid_y + inflated.y);
+
+    double a = mu20 * inverse_m00;
+    double b = mu11 * inverse_m00;
+    double c = mu02 * inverse_m00;
+
+    double square = sqrt(4 * b * b + (a - c) * (a - c));
+    double theta = atan2(2 * b, a - c + square);
+
+    double cs = cos(theta);
+    double sn = sin(theta);
+
+    double rotate_a = cs * cs * mu20 + 2 * cs * sn * mu11 + sn * sn * mu02;
+    double rotate_c = sn * sn * mu20 - 2 * cs * sn * mu11 + cs * cs * mu02;
+
+    double length = sqrt(max(rotate_a, 0.) * inverse_m00) * 4;
+    double width = sqrt(max(rotate_c, 0.) * inverse_m00) * 4;
+
+    if (length < width) {
+        swap(length, width);
+        swap(cs, sn);
+        theta = CV_PI * 0.5 - theta;
+    }
+
+    // Next search window covers the box
+    fit_window(window, xc, yc, max(cvRound(fabs(length * cs)), cvRound(fabs(width * sn))), max(cvRound(fabs(length * sn)), cvRound(fabs(width * cs))));
+
+    RotatedRect box;
+    box.size.height = (float) length;
+    box.size.width = (float) width;
+    box.angle = (float) ((CV_PI * 0.5 + theta) * 180. / CV_PI);
+    while (box.angle < 0) {
+        box.angle += 360;
+    }
+    while (box.angle >= 360) {
+        box.angle -= 360;
+    }
+    if (box.angle >= 180) {
+        box.angle -= 180;
+    }
+    box.center = Point2f(window.x + window.width * 0.5f, window.y + window.height * 0.5f);
+
+    result.box = box;
+}
+
+/**
+ * Integer version of estimate_box.
+ *
+ * Second order moments are exact integers. Eigenvalues of the covariance
+ * are kept in Q8 pixels squared and their square roots in Q8 pixels, so
+ * the box size is truncated to 1/256 pixel. Orientation comes from CORDIC
+ * and is within 0.01 degree of the floating point result. Width and height
+ * of the next window are rounded from Q8 size and Q16 sine and cosine, and
+ * can differ from the floating point path by one pixel.
+ *
+ * @param inflated window the moments were taken over
+ * @param m00
+ * @param m10
+ * @param m01
+ * @param window replaced by the next search window
+ * @param result
+ */
+void IntegralCamShift::estimate_box_integer(const Rect& inflated, int64 m00, int64 m10, int64 m01, Rect& window, CamShiftResult& result) const {
+
+    // First moments relative to the inflated window
+    int64 local_m10 = m10 - (int64) (inflated.x - region.x) * m00;
+    int64 local_m01 = m01 - (int64) (inflated.y - region.y) * m00;
+
+    // Raw second order moments relative to the inflated window
+    int64 m20 = 0, m02 = 0, m11 = 0;
+
+    for (int y = 0; y < inflated.height; y++) {
+
+        const uchar * pixel = image.ptr<uchar>(inflated.y + y) + inflated.x;
+
+        int64 row_sum = 0, row_x = 0, row_xx = 0;
+
+        for (int x = 0; x < inflated.width; x++) {
+            int weight = pixel[x];
+            row_sum += weight;
+            row_x += weight * x;
+            row_xx += (int64) weight * x * x;
+        }
+
+        m20 += row_xx;
+        m11 += row_x * y;
+        m02 += row_sum * y * y;
+
+    }
+
+    // Central moments
+    int64 mu20 = m20 - product_over(local_m10, local_m10, m00);
+    int64 mu02 = m02 - product_over(local_m01, local_m01, m00);
+    int64 mu11 = m11 - product_over(local_m10, local_m01, m00);
+
+    // Covariance in Q8
+    int64 a = (mu20 << 8) / m00;
+    int64 b = (mu11 << 8) / m00;
+    int64 c = (mu02 << 8) / m00;
+
+    // Eigenvalues in Q8
+    int64 half_difference = (a - c) / 2;
+    int64 root = (int64) FixedPoint::sqrt((uint64_t) (half_difference * half_difference + b * b));
+    int64 major = max((a + c) / 2 + root, (int64) 0);
+    int64 minor = max((a + c) / 2 - root, (int64) 0);
+
+    // Axis lengths are four standard deviations, in Q8
+    int64 length = 4 * (int64) FixedPoint::sqrt((uint64_t) major << 8);
+    int64 width = 4 * (int64) FixedPoint::sqrt((uint64_t) minor << 8);
+
+    // Orientation of the major axis
+    int32_t theta = FixedPoint::atan2(2 * mu11, mu20 - mu02) / 2;
+
+    int32_t sn, cs;
+    FixedPoint::sin_cos(theta, sn, cs);
+
+    int xc = (int) FixedPoint::divide_round(local_m10, m00) + inflated.x;
+    int yc = (int) FixedPoint::divide_round(local_m01, m00) + inflated.y;
+
+    // Axis projections in pixels from Q8 lengths and Q16 sine and cosine
+    const int64 ROUND = (int64) 1 << 23;
+    int64 abs_cs = cs < 0 ? -cs : cs;
+    int64 abs_sn = sn < 0 ? -sn : sn;
+
+    int box_width = (int) max((length * abs_cs + ROUND) >> 24, (width * abs_sn + ROUND) >> 24);
+    int box_height = (int) max((length * abs_sn + ROUND) >> 24, (width * abs_cs + ROUND) >> 24);
+
+    fit_window(window, xc, yc, box_width, box_height);
+
+    // Angle in Q16 degrees in range 0-180, rounded. PI / 2 + theta is never
+    // negative, so the rounding offset can be added before the division.
+    int64 angle = ((((int64) (FixedPoint::PI / 2 + theta) << FixedPoint::ANGLE_BITS) * 180) + FixedPoint::PI / 2) / FixedPoint::PI;
+    const int64 HALF_TURN = (int64) 180 << FixedPoint::ANGLE_BITS;
+    angle %= HALF_TURN;
+    if (angle < 0) {
+        angle += HALF_TURN;
+    }
+
+    RotatedRect box;
+    box.size.height = length / 256.f;
+    box.size.width = width / 256.f;
+    box.angle = angle / (float) (1 << FixedPoint::ANGLE_BITS);
+    box.center = Point2f(window.x + window.width * 0.5f, window.y + window.height * 0.5f);
+
+    result.box = box;
+}
+
+/**
+ * Set the next search window around the box center, clipped to the image.
+ *
+ * @param window
+ * @param xc box center x
+ * @param yc box center y
+ * @param box_width width of the box projected on x axis
+ * @param box_height height of the box projected on y axis
+ */
+void IntegralCamShift::fit_window(Rect& window, int xc, int yc, int box_width, int box_height) const {
+
+    window.width = min(box_width + 2, (image.cols - xc) * 2);
+    window.height = min(box_height + 2, (image.rows - yc) * 2);
+
+    window.x = max(0, xc - window.width / 2);
+    window.y = max(0, yc - window.height / 2);
+    window.width = min(image.cols - window.x, window.width);
+    window.height = min(image.rows - window.y, window.height);
+}
+
+/**
+ * Use integer arithmetic for mean shift steps and box estimation.
+ *
+ * @param enabled
+ */
+void IntegralCamShift::set_integer_arithmetic(bool enabled) {
+    integer_arithmetic = enabled;
+}
+
+/**
+ * CamShift from one initial window.
+ *
+ * @param window initial search window
+ * @param criteria mean shift termination criteria
+ * @return
+ */
+CamShiftResult IntegralCamShift::track(Rect window, const TermCriteria& criteria) const {
+    return track(vector<Rect>(1, window), criteria);
+}
+
+/**
+ * CamShift from several candidate windows. The candidate that converges
+ * to the most back projection mass wins.
+ *
+ * @param candidates initial search windows
+ * @param criteria mean shift termination criteria
+ * @return
+ */
+CamShiftResult IntegralCamShift::track(const vector<Rect>& candidates, const TermCriteria& criteria) const {
+
+    CamShiftResult best;
+    int64 best_mass = -1;
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+
+        Rect window = candidates[i];
+        bool converged;
+        int iterations = mean_shift(window, criteria, converged);
+
+        int64 window_mass = mass(window);
+
+        if (window_mass > best_mass) {
+            best_mass = window_mass;
+            best.window = window;
+            best.iterations = iterations;
+            best.converged = converged;
+        }
+
+    }
+
+    if (best_mass < 0 || region.area() == 0) {
+        return best;
+    }
+
+    // Size and orientation only for the winner
+    Rect window = best.window;
+    estimate_box(window, best);
+    best.window = window;
+
+    if (best.box.size.width > 0 && best.box.size.height > 0) {
+        double box_area = CV_PI * 0.25 * best.box.size.width * best.box.size.height;
+        best.confidence = min(best.mass / (255. * box_area), 1.);
+        if (!best.converged) {
+            best.confidence *= 0.5;
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,108 @@
+/*
+ * File:   IntegralCamShift.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef INTEGRALCAMSHIFT_HPP
+#define INTEGRALCAMSHIFT_HPP
+
+#include "opencv2/opencv.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Result of one CamShift run.
+ */
+struct CamShiftResult {
+
+    // Oriented bounding box of the object, empty if the window has no mass
+    RotatedRect box;
+
+    // Search window for the next frame
+    Rect window;
+
+    // Number of mean shift iterations
+    int iterations = 0;
+
+    // Mean shift stopped on the epsilon criterion and not on iteration count
+    bool converged = false;
+
+    // Sum of back projection in the final window
+    double mass = 0;
+
+    // Tracking confidence in range 0-1
+    double confidence = 0;
+
+};
+
+/**
+ * CamShift on integral images of the back projection.
+ *
+ * Integral images of the back projection and of its x and y weighted
+ * values are built once per frame. Every mean shift step then reads the
+ * zeroth and first moments of the window in O(1), so many iterations and
+ * several candidate windows cost almost nothing over building the
+ * integrals. Second order moments for the size and orientation are
+ * evaluated once, over the final window only.
+ *
+ * In fixed point mode all moments, mean shift steps, size and orientation
+ * are computed in integer arithmetic, see estimate_box_integer for the
+ * precision. Only the returned box is converted to float.
+ */
+class IntegralCamShift {
+public:
+
+    IntegralCamShift();
+    IntegralCamShift(const IntegralCamShift& orig) = delete;
+    IntegralCamShift& operator=(const IntegralCamShift& orig) = delete;
+    virtual ~IntegralCamShift();
+
+    void set_image(const Mat&, const Rect&);
+
+    int mean_shift(Rect&, const TermCriteria&, bool&) const;
+
+    CamShiftResult track(Rect, const TermCriteria&) const;
+
+    CamShiftResult track(const vector<Rect>&, const TermCriteria&) const;
+
+    int64 mass(const Rect&) const;
+
+    void masses(const int*, const int*, const int*, const int*, int, int64*) const;
+
+    Rect get_region() const;
+
+    void set_integer_arithmetic(bool);
+
+private:
+
+    // Back projection
+    Mat image;
+
+    // Region of the back projection covered by integrals
+    Rect region;
+
+    // Integral images of the back projection and its x and y weighted
+    // values, in region coordinates, with one extra row and column
+    vector<int64> sum;
+    vector<int64> sum_x;
+    vector<int64> sum_y;
+
+    // Row length of integral images
+    int stride;
+
+    // Integer arithmetic only
+    bool integer_arithmetic = false;
+
+    void moments(const Rect&, int64&, int64&, int64&) const;
+
+    void estimate_box(Rect&, CamShiftResult&) const;
+
+    void estimate_box_integer(const Rect&, int64, int64, int64, Rect&, CamShiftResult&) const;
+
+    void fit_window(Rect&, int, int, int, int) const;
+
+};
+
+#endif /* INTEGRALCAMSHIFT_HPP */
+
@@ -0,0 +1,427 @@
+/*
+ * File:   LatencyProbe.cpp
+ * Author: Jan Dufek
+ */
+
+#include "LatencyProbe.hpp"
+#include "VictimTracker.hpp"
+#include "StreamSupervisor.hpp"
+#include "Tracer.hpp"
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Stamp grid, 32 bit counter, 48 bit time in microseconds and 16 bit checksum
+static const int STAMP_COLUMNS = 16;
+static const int STAMP_ROWS = 6;
+static const int STAMP_BYTES = STAMP_COLUMNS * STAMP_ROWS / 8;
+
+// Cells across the frame width and height. Cells are a fixed fraction of
+// the frame, so a stamp survives resizing of the frame on the way.
+static const int GRID_COLUMNS = 80;
+static const int GRID_ROWS = 45;
+
+LatencyProbe::LatencyProbe(Settings& s) {
+
+    settings = &s;
+
+    unreadable_frames = 0;
+    last_counter = -1;
+    skipped_frames = 0;
+
+}
+
+LatencyProbe::~LatencyProbe() {
+}
+
+/**
+ * Rectangle of a stamp cell. At the generated 1280x720 cells are 16 pixels,
+ * large enough to survive chroma subsampling and quantization of the
+ * encoder. Grid lines are rounded, so cells differ by at most one pixel.
+ *
+ * @param frame_size
+ * @param column
+ * @param row
+ * @return
+ */
+Rect LatencyProbe::cell_rect(Size frame_size, int column, int row) {
+
+    int left = cvRound((double) column * frame_size.width / GRID_COLUMNS);
+    int top = cvRound((double) row * frame_size.height / GRID_ROWS);
+    int right = cvRound((double) (column + 1) * frame_size.width / GRID_COLUMNS);
+    int bottom = cvRound((double) (row + 1) * frame_size.height / GRID_ROWS);
+
+    return Rect(left, top, right - left, bottom - top);
+}
+
+/**
+ * Fletcher-16 checksum with both sums starting at one, so that a black
+ * frame does not read as a stamp. All zero bytes pass the plain checksum.
+ *
+ * @param data
+ * @param length
+ * @return
+ */
+uint16_t LatencyProbe::checksum(const uint8_t * data, int length) {
+
+    uint16_t sum_1 = 1;
+    uint16_t sum_2 = 1;
+
+    for (int i = 0; i < length; i++) {
+        sum_1 = (sum_1 + data[i]) % 255;
+        sum_2 = (sum_2 + sum_1) % 255;
+    }
+
+    return (sum_2 << 8) | sum_1;
+}
+
+/**
+ * Stamp frame counter and time into the top left corner. The grid is
+ * surrounded by a black border of one cell.
+ *
+ * @param frame BGR frame
+ * @param counter
+ * @param time_us monotonic time in microseconds
+ */
+void LatencyProbe::stamp(Mat& frame, uint32_t counter, int64_t time_us) {
+
+    uint8_t bytes[STAMP_BYTES];
+
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (counter >> (8 * i)) & 0xFF;
+    }
+
+    for (int i = 0; i < 6; i++) {
+        bytes[4 + i] = (time_us >> (8 * i)) & 0xFF;
+    }
+
+    uint16_t sum = checksum(bytes, 10);
+    bytes[10] = sum & 0xFF;
+    bytes[11] = sum >> 8;
+
+    Rect border = cell_rect(frame.size(), 0, 0) | cell_rect(frame.size(), STAMP_COLUMNS + 1, STAMP_ROWS + 1);
+
+    rectangle(frame, border, Scalar::all(0), -1);
+
+    for (int bit = 0; bit < STAMP_BYTES * 8; bit++) {
+        if (bytes[bit / 8] & (1 << (bit % 8))) {
+            rectangle(frame, cell_rect(frame.size(), 1 + bit % STAMP_COLUMNS, 1 + bit / STAMP_COLUMNS), Scalar::all(255), -1);
+        }
+    }
+}
+
+/**
+ * Read a stamp back. Only the inner half of every cell is sampled, so
+ * blurred cell edges do not matter. The grid is relative to the frame, so
+ * a frame resized after stamping reads back the same.
+ *
+ * @param frame BGR frame
+ * @param counter
+ * @param time_us monotonic time in microseconds
+ * @return false if there is no stamp or the checksum does not match
+ */
+bool LatencyProbe::read_stamp(const Mat& frame, uint32_t& counter, int64_t& time_us) {
+
+    // Inner half of a cell has to keep at least one pixel
+    if (frame.cols < 2 * GRID_COLUMNS || frame.rows < 2 * GRID_ROWS) {
+        return false;
+    }
+
+    uint8_t bytes[STAMP_BYTES] = {0};
+
+    for (int bit = 0; bit < STAMP_BYTES * 8; bit++) {
+
+        Rect cell = cell_rect(frame.size(), 1 + bit % STAMP_COLUMNS, 1 + bit / STAMP_COLUMNS);
+        Rect inner(cell.x + cell.width / 4, cell.y + cell.height / 4, max(cell.width / 2, 1), max(cell.height / 2, 1));
+        Scalar level = mean(frame(inner));
+
+        if ((level[0] + level[1] + level[2]) / 3 > 128) {
+            bytes[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+
+    if (checksum(bytes, 10) != (uint16_t) (bytes[10] | (bytes[11] << 8))) {
+        return false;
+    }
+
+    counter = 0;
+    for (int i = 0; i < 4; i++) {
+        counter |= (uint32_t) bytes[i] << (8 * i);
+    }
+
+    time_us = 0;
+    for (int i = 0; i < 6; i++) {
+        time_us |= (int64_t) bytes[4 + i] << (8 * i);
+    }
+
+    return true;
+}
+
+/**
+ * Render a red target circling over water once every ten seconds.
+ *
+ * @param frame
+ * @param frame_index
+ */
+void LatencyProbe::render_scene(Mat& frame, int64_t frame_index) {
+
+    frame.setTo(Scalar(110, 80, 30));
+
+    double angle = 2 * CV_PI * frame_index / (settings->latency_fps * 10);
+
+    Point center(frame.cols / 2 + cvRound(frame.cols / 4 * cos(angle)), frame.rows / 2 + cvRound(frame.rows / 4 * sin(angle)));
+
+    circle(frame, center, max(frame.rows / 20, 2), Scalar(0, 0, 220), -1);
+}
+
+/**
+ * Generate stamped frames in real time and encode them with ffmpeg into a
+ * file or a stream.
+ *
+ * @param output file name or stream URL, udp:// and tcp:// are sent as
+ * MPEG-TS and rtmp:// as FLV
+ * @param seconds
+ * @return 0 on success, -1 if ffmpeg cannot be started
+ */
+int LatencyProbe::generate(const string& output, double seconds) {
+
+    Size size = settings->latency_frame_size;
+    double fps = settings->latency_fps;
+
+    vector<string> arguments;
+    arguments.push_back("ffmpeg");
+    arguments.push_back("-loglevel");
+    arguments.push_back("error");
+    arguments.push_back("-f");
+    arguments.push_back("rawvideo");
+    arguments.push_back("-pix_fmt");
+    arguments.push_back("bgr24");
+    arguments.push_back("-s");
+    arguments.push_back(to_string(size.width) + "x" + to_string(size.height));
+    arguments.push_back("-r");
+    arguments.push_back(to_string(fps));
+    arguments.push_back("-i");
+    arguments.push_back("-");
+    arguments.push_back("-c:v");
+    arguments.push_back("libx264");
+    arguments.push_back("-preset");
+    arguments.push_back("ultrafast");
+    arguments.push_back("-tune");
+    arguments.push_back("zerolatency");
+    arguments.push_back("-g");
+    arguments.push_back(to_string(cvRound(fps)));
+
+    if (output.compare(0, 6, "udp://") == 0 || output.compare(0, 6, "tcp://") == 0) {
+        arguments.push_back("-f");
+        arguments.push_back("mpegts");
+    } else if (output.compare(0, 7, "rtmp://") == 0) {
+        arguments.push_back("-f");
+        arguments.push_back("flv");
+    }
+
+    arguments.push_back("-y");
+    arguments.push_back(output);
+
+    int descriptors[2];
+
+    if (pipe(descriptors) != 0) {
+        cout << "Cannot create pipe to ffmpeg" << endl;
+        return -1;
+    }
+
+    pid_t encoder_process = fork();
+
+    if (encoder_process == 0) {
+
+        dup2(descriptors[0], STDIN_FILENO);
+        close(descriptors[0]);
+        close(descriptors[1]);
+
+        vector<char *> argv;
+        for (size_t i = 0; i < arguments.size(); i++) {
+            argv.push_back(const_cast<char *> (arguments[i].c_str()));
+        }
+        argv.push_back(NULL);
+
+        execvp("ffmpeg", argv.data());
+        _exit(127);
+    }
+
+    close(descriptors[0]);
+
+    if (encoder_process < 0) {
+        close(descriptors[1]);
+        cout << "Cannot start ffmpeg" << endl;
+        return -1;
+    }
+
+    // A closed stream ends the generation instead of the process
+    signal(SIGPIPE, SIG_IGN);
+
+    Mat frame(size, CV_8UC3);
+    size_t frame_bytes = frame.total() * frame.elemSize();
+
+    int64_t frames = (int64_t) (seconds * fps);
+    int64_t start = Tracer::now();
+    int64_t frame_index;
+
+    for (frame_index = 0; frame_index < frames; frame_index++) {
+
+        // Keep the frame rate of a camera
+        int64_t due = start + (int64_t) (frame_index * 1e9 / fps);
+        int64_t wait = due - Tracer::now();
+        if (wait > 0) {
+            usleep((useconds_t) (wait / 1000));
+        }
+
+        render_scene(frame, frame_index);
+
+        // The stamp is the moment the frame leaves the glass
+        stamp(frame, (uint32_t) frame_index, Tracer::now() / 1000);
+
+        size_t written = 0;
+        while (written < frame_bytes) {
+            ssize_t result = write(descriptors[1], frame.data + written, frame_bytes - written);
+            if (result <= 0) {
+                break;
+            }
+            written += result;
+        }
+
+        if (written < frame_bytes) {
+            cout << "ffmpeg stopped accepting frames" << endl;
+            break;
+        }
+    }
+
+    close(descriptors[1]);
+    waitpid(encoder_process, NULL, 0);
+
+    cout << "Generated " << frame_index << " stamped frames to " << output << endl;
+
+    return 0;
+}
+
+/**
+ * Measure latency from generation to the published tracking result. A
+ * stream is generated by a child process while it is tracked, a file is
+ * generated first and then read.
+ *
+ * @param source file name or stream URL
+ * @param seconds
+ * @return 0 if any stamp was read, -1 otherwise
+ */
+int LatencyProbe::run(const string& source, double seconds) {
+
+    bool is_file = !StreamSupervisor::is_live(source);
+
+    pid_t generator_process = 0;
+
+    if (is_file) {
+
+        if (generate(source, seconds) != 0) {
+            return -1;
+        }
+
+    } else {
+
+        generator_process = fork();
+
+        if (generator_process == 0) {
+            _exit(generate(source, seconds) == 0 ? 0 : 1);
+        }
+
+        if (generator_process < 0) {
+            cout << "Cannot start the generator" << endl;
+            return -1;
+        }
+    }
+
+    StreamSupervisor stream_supervisor(* settings);
+    stream_supervisor.open(source);
+
+    VictimTracker * tracker = NULL;
+    Mat frame;
+
+    // Give the stream a few seconds to come up and to drain
+    int64_t end = Tracer::now() + (int64_t) ((seconds + 5) * 1e9);
+
+    while (!stream_supervisor.has_ended() && (is_file || Tracer::now() < end)) {
+
+        if (!stream_supervisor.read(frame)) {
+            continue;
+        }
+
+        if (tracker == NULL) {
+            tracker = new VictimTracker(frame.size(), settings->latency_fps, SINK_NONE);
+        }
+
+        tracker->push(frame);
+
+        // The result has been published
+        record(frame);
+    }
+
+    delete tracker;
+
+    if (generator_process > 0) {
+        kill(generator_process, SIGINT);
+        waitpid(generator_process, NULL, 0);
+    }
+
+    print_report();
+
+    return latencies.empty() ? -1 : 0;
+}
+
+/**
+ * Record the age of a frame whose result has just been published.
+ *
+ * @param frame
+ */
+void LatencyProbe::record(const Mat& frame) {
+
+    uint32_t counter;
+    int64_t time_us;
+
+    if (!read_stamp(frame, counter, time_us)) {
+        unreadable_frames++;
+        return;
+    }
+
+    latencies.push_back((Tracer::now() / 1000 - time_us) / 1000.);
+
+    // Frames dropped by the encoder, the network or the capture backend
+    if (last_counter >= 0 && counter > last_counter + 1) {
+        skipped_frames += counter - last_counter - 1;
+    }
+
+    last_counter = counter;
+}
+
+/**
+ * Print the distribution of frame ages.
+ */
+void LatencyProbe::print_report() {
+
+    if (latencies.empty()) {
+        cout << "No latency stamps read, " << unreadable_frames << " frames without stamp" << endl;
+        return;
+    }
+
+    vector<double> sorted = latencies;
+    sort(sorted.begin(), sorted.end());
+
+    double total = 0;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        total += sorted[i];
+    }
+
+    size_t count = sorted.size();
+
+    cout << "Glass-to-output latency over " << count << " frames (" << unreadable_frames << " without stamp, " << skipped_frames << " skipped):" << endl;
+    cout << "    min " << sorted[0] << " ms, mean " << total / count << " ms" << endl;
+    cout << "    p50 " << sorted[count / 2] << " ms, p90 " << sorted[count * 9 / 10] << " ms, p99 " << sorted[count * 99 / 100] << " ms" << endl;
+    cout << "    max " << sorted[count - 1] << " ms" << endl;
+}
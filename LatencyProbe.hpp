@@ -0,0 +1,77 @@
+/*
+ * File:   LatencyProbe.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef LATENCYPROBE_HPP
+#define LATENCYPROBE_HPP
+
+#include <stdint.h>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Glass-to-output latency of the whole capture and tracking path.
+ *
+ * A synthetic source renders a red target circling over water and stamps
+ * the frame counter and the monotonic generation time into the top left
+ * corner as a grid of black and white cells with a checksum. Cells are a
+ * fixed fraction of the frame size, so the tracker reads them at any
+ * processing resolution. Frames are
+ * encoded by ffmpeg into a file or a loopback stream, so they go through
+ * the same VideoCapture backend and its buffers as camera streams.
+ *
+ * On the tracker side the stamp is read back from each pushed frame once
+ * its result is published, and the age of the frame is recorded. Both
+ * sides use CLOCK_MONOTONIC, so they have to run on the same machine.
+ * Ages of frames read from a file include the time the file waited on disk
+ * and only check the stamp path.
+ */
+class LatencyProbe {
+public:
+
+    LatencyProbe(Settings&);
+    LatencyProbe(const LatencyProbe& orig) = delete;
+    LatencyProbe& operator=(const LatencyProbe& orig) = delete;
+    virtual ~LatencyProbe();
+
+    int generate(const string&, double);
+
+    int run(const string&, double);
+
+    void record(const Mat&);
+
+    void print_report();
+
+    static void stamp(Mat&, uint32_t, int64_t);
+
+    static bool read_stamp(const Mat&, uint32_t&, int64_t&);
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Frame ages in milliseconds
+    vector<double> latencies;
+
+    // Frames without a readable stamp
+    long unreadable_frames;
+
+    // Counter of the last stamp and frames missing between stamps
+    int64_t last_counter;
+    long skipped_frames;
+
+    static Rect cell_rect(Size, int, int);
+
+    static uint16_t checksum(const uint8_t*, int);
+
+    void render_scene(Mat&, int64_t);
+
+};
+
+#endif /* LATENCYPROBE_HPP */
+
@@ -11,9 +11,6 @@ Logger::Logger(string name) {
 
 }
 
-Logger::Logger(const Logger& orig) {
-}
-
 Logger::~Logger() {
     close();
 }
@@ -14,7 +14,8 @@ class Logger {
 public:
     Logger();
     Logger(string);
-    Logger(const Logger& orig);
+    Logger(const Logger& orig) = delete;
+    Logger& operator=(const Logger& orig) = delete;
     virtual ~Logger();
     
     void log_general(string);
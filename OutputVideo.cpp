@@ -16,9 +16,6 @@ OutputVideo::OutputVideo(double f, Size s, string n) {
     
 }
 
-OutputVideo::OutputVideo(const OutputVideo& orig) {
-}
-
 OutputVideo::~OutputVideo() {
 }
 
@@ -14,7 +14,8 @@ using namespace std;
 class OutputVideo {
 public:
     OutputVideo(double, Size, string);
-    OutputVideo(const OutputVideo& orig);
+    OutputVideo(const OutputVideo& orig) = delete;
+    OutputVideo& operator=(const OutputVideo& orig) = delete;
     virtual ~OutputVideo();
     
     VideoWriter get_video_writer();
@@ -0,0 +1,118 @@
+/*
+ * File:   Overlay.cpp
+ * Author: Jan Dufek
+ */
+
+#include "Overlay.hpp"
+
+Overlay::Overlay(Settings& s, Size sz) {
+
+    settings = &s;
+
+    video_size = sz;
+
+}
+
+Overlay::~Overlay() {
+}
+
+/**
+ * Draws bounding ellipse and crosshairs of the tracked object.
+ * 
+ * @param frame frame to which draw into
+ * @param box tracked object
+ */
+void Overlay::draw_track(Mat& frame, const RotatedRect& box) {
+
+    if (box.size.height <= 0 || box.size.width <= 0) {
+        return;
+    }
+
+    // Draw bounding ellipse
+    ellipse(frame, box, settings->LOCATION_COLOR, settings->LOCATION_THICKNESS, LINE_AA);
+
+    // Draw cross hairs
+    draw_position(box.center.x, box.center.y, min(box.size.width, box.size.height) / 2, frame);
+}
+
+/**
+ * Draws position of the object as crosshairs with the center in the object's
+ * centroid.
+ * 
+ * @param x x coordinate
+ * @param y y coordinate
+ * @param radius radius of crosshairs
+ * @param frame frame to which draw into
+ */
+void Overlay::draw_position(int x, int y, double radius, Mat &frame) {
+
+    // Lines
+    if (y - radius > 0) {
+        line(frame, Point(x, y), Point(x, y - radius), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    } else {
+        line(frame, Point(x, y), Point(x, 0), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    }
+
+    if (y + radius < video_size.height) {
+        line(frame, Point(x, y), Point(x, y + radius), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    } else {
+        line(frame, Point(x, y), Point(x, video_size.height), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    }
+
+    if (x - radius > 0) {
+        line(frame, Point(x, y), Point(x - radius, y), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    } else {
+        line(frame, Point(x, y), Point(0, y), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    }
+
+    if (x + radius < video_size.width) {
+        line(frame, Point(x, y), Point(x + radius, y), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    } else {
+        line(frame, Point(x, y), Point(video_size.width, y), settings->LOCATION_COLOR, settings->LOCATION_THICKNESS);
+    }
+
+    // Text coordinates
+    putText(frame, "[" + int_to_string(x) + "," + int_to_string(y) + "]", Point(x, y + radius + 20), 1, 1, settings->LOCATION_COLOR, 1, 8);
+}
+
+/**
+ * Prints current status to the GUI.
+ * 
+ * @param frame
+ * @param status
+ * @param time_to_target
+ */
+void Overlay::print_status(Mat& frame, int status) {
+
+    String stringStatus;
+
+    switch (status) {
+        case 0:
+            stringStatus = "Initialization";
+            break;
+        case 1:
+            stringStatus = "Select EMILY and target.";
+            break;
+        case 2:
+            stringStatus = "Target set. Getting orientation.";
+            break;
+        case 3:
+            stringStatus = "Target set. Going to target.";
+            break;
+    }
+
+    // Print status
+    putText(frame, stringStatus, Point(50, 50), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 0, 255), 2);
+}
+
+/**
+ * Convert integer to string.
+ * 
+ * @param number integer to be converted to string
+ * 
+ */
+string Overlay::int_to_string(int number) {
+    stringstream stringStream;
+    stringStream << number;
+    return stringStream.str();
+}
@@ -0,0 +1,45 @@
+/*
+ * File:   Overlay.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef OVERLAY_HPP
+#define OVERLAY_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Draws the tracking result and status into frames, live or when rendering
+ * a recorded track offline.
+ */
+class Overlay {
+public:
+
+    Overlay(Settings&, Size);
+    Overlay(const Overlay& orig) = delete;
+    Overlay& operator=(const Overlay& orig) = delete;
+    virtual ~Overlay();
+
+    void draw_track(Mat&, const RotatedRect&);
+
+    void draw_position(int, int, double, Mat&);
+
+    void print_status(Mat&, int);
+
+private:
+
+    string int_to_string(int);
+
+    // Program settings
+    Settings * settings;
+
+    // Size of frames drawn into
+    Size video_size;
+
+};
+
+#endif /* OVERLAY_HPP */
@@ -0,0 +1,217 @@
+/*
+ * File:   OverlayRenderer.cpp
+ * Author: Jan Dufek
+ */
+
+#include "OverlayRenderer.hpp"
+#include "OutputVideo.hpp"
+#include "TrackRecorder.hpp"
+
+#include <cfloat>
+
+OverlayRenderer::OverlayRenderer(Settings& s) {
+
+    settings = &s;
+
+}
+
+OverlayRenderer::~OverlayRenderer() {
+}
+
+/**
+ * Read header and records of a track file.
+ *
+ * @param track_name
+ * @param source source video written in the header
+ * @param alignment "frame" or "time"
+ * @param anchor thumbnail of the first recorded frame, empty if there is none
+ * @param records
+ * @return false if the file cannot be read
+ */
+bool OverlayRenderer::read_track(const string& track_name, string& source, string& alignment, Mat& anchor, vector<TrackRecord>& records) {
+
+    ifstream track_file(track_name.c_str());
+
+    if (!track_file.is_open()) {
+        cout << "Cannot open the track file " << track_name << endl;
+        return false;
+    }
+
+    string line;
+
+    while (getline(track_file, line)) {
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        istringstream fields(line);
+
+        // Header lines start with a key
+        if (!isdigit((unsigned char) line[0])) {
+            string key;
+            fields >> key;
+
+            if (key == "source") {
+                fields >> source;
+            } else if (key == "alignment") {
+                fields >> alignment;
+            } else if (key == "anchor") {
+
+                int width = 0, height = 0;
+                fields >> width >> height;
+
+                anchor.create(max(height, 0), max(width, 0), CV_8UC1);
+
+                for (int i = 0; i < width * height; i++) {
+                    int value = 0;
+                    fields >> value;
+                    anchor.at<uchar>(i / width, i % width) = saturate_cast<uchar> (value);
+                }
+
+                if (fields.fail()) {
+                    cout << "Damaged anchor in " << track_name << ", aligning from the start" << endl;
+                    anchor.release();
+                }
+            }
+
+            continue;
+        }
+
+        TrackRecord record;
+        int valid;
+
+        fields >> record.frame >> record.time >> valid >> record.box.center.x >> record.box.center.y >> record.box.size.width >> record.box.size.height >> record.box.angle;
+
+        double confidence;
+        fields >> confidence >> record.status;
+
+        if (!valid) {
+            record.box.size = Size2f(0, 0);
+        }
+
+        records.push_back(record);
+    }
+
+    return true;
+}
+
+/**
+ * Find the anchor frame in the first overlay_anchor_search_seconds of the
+ * source by the smallest mean absolute thumbnail difference.
+ *
+ * @param source_name
+ * @param anchor thumbnail of the first recorded frame
+ * @return time of the anchor frame in the source in milliseconds, 0 if the
+ * source cannot be read
+ */
+double OverlayRenderer::find_anchor(const string& source_name, const Mat& anchor) {
+
+    VideoCapture video_capture(source_name);
+
+    Mat frame, thumbnail, difference;
+
+    double best_time = 0;
+    double best_difference = DBL_MAX;
+
+    while (video_capture.read(frame)) {
+
+        double time = video_capture.get(CV_CAP_PROP_POS_MSEC);
+
+        if (time > settings->overlay_anchor_search_seconds * 1000) {
+            break;
+        }
+
+        thumbnail = TrackRecorder::thumbnail(frame);
+
+        if (thumbnail.size() != anchor.size()) {
+            break;
+        }
+
+        absdiff(thumbnail, anchor, difference);
+        double mean_difference = mean(difference)[0];
+
+        if (mean_difference < best_difference) {
+            best_difference = mean_difference;
+            best_time = time;
+        }
+    }
+
+    cout << "Track starts at " << best_time << " ms of " << source_name << endl;
+
+    return best_time;
+}
+
+/**
+ * Draw the track onto the source video and encode the result.
+ *
+ * @param track_name track file written by TrackRecorder
+ * @param source_name source video, or empty to use the one in the track
+ * @param output_name output file name without extension, or empty to use the track name
+ * @return 0 on success, -1 on error
+ */
+int OverlayRenderer::run(const string& track_name, string source_name, string output_name) {
+
+    string source;
+    string alignment = "frame";
+    Mat anchor;
+    vector<TrackRecord> records;
+
+    if (!read_track(track_name, source, alignment, anchor, records)) {
+        return -1;
+    }
+
+    if (source_name.empty()) {
+        source_name = source;
+    }
+
+    if (output_name.empty()) {
+        output_name = track_name.substr(0, track_name.rfind('.')) + "_rendered";
+    }
+
+    VideoCapture video_capture(source_name);
+
+    if (!video_capture.isOpened()) {
+        cout << "Cannot open the source video " << source_name << endl;
+        return -1;
+    }
+
+    // Time of the first recorded frame in the source
+    double offset = (alignment == "time" && !anchor.empty()) ? find_anchor(source_name, anchor) : 0;
+
+    double fps = video_capture.get(CV_CAP_PROP_FPS);
+    Size size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+
+    OutputVideo output_video(fps > 0 ? fps : 30, size, output_name);
+    VideoWriter video_writer = output_video.get_video_writer();
+
+    Overlay overlay(* settings, size);
+
+    Mat frame;
+    int64 frame_number = 0;
+    size_t record = 0;
+
+    while (video_capture.read(frame)) {
+
+        // Position of this frame on the axis the track is aligned by
+        int64 position = (alignment == "time") ? (int64) (video_capture.get(CV_CAP_PROP_POS_MSEC) - offset) : frame_number;
+
+        // Advance to the last record at or before this frame
+        while (record + 1 < records.size() && (alignment == "time" ? records[record + 1].time : records[record + 1].frame) <= position) {
+            record++;
+        }
+
+        if (record < records.size() && (alignment == "time" ? records[record].time : records[record].frame) <= position) {
+            overlay.draw_track(frame, records[record].box);
+            overlay.print_status(frame, records[record].status);
+        }
+
+        video_writer << frame;
+
+        frame_number++;
+    }
+
+    cout << "Rendered " << frame_number << " frames to " << output_name << ".avi" << endl;
+
+    return 0;
+}
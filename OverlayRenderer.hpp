@@ -0,0 +1,51 @@
+/*
+ * File:   OverlayRenderer.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef OVERLAYRENDERER_HPP
+#define OVERLAYRENDERER_HPP
+
+#include <fstream>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "Overlay.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Composites a recorded track onto the source video after the mission.
+ */
+class OverlayRenderer {
+public:
+
+    OverlayRenderer(Settings&);
+    OverlayRenderer(const OverlayRenderer& orig) = delete;
+    OverlayRenderer& operator=(const OverlayRenderer& orig) = delete;
+    virtual ~OverlayRenderer();
+
+    int run(const string&, string, string);
+
+private:
+
+    /**
+     * One line of the track file.
+     */
+    struct TrackRecord {
+        int64 frame;
+        int64 time;
+        RotatedRect box;
+        int status;
+    };
+
+    Settings * settings;
+
+    bool read_track(const string&, string&, string&, Mat&, vector<TrackRecord>&);
+
+    double find_anchor(const string&, const Mat&);
+
+};
+
+#endif /* OVERLAYRENDERER_HPP */
+
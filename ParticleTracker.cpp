@@ -0,0 +1,427 @@
+/*
+ * File:   ParticleTracker.cpp
+ * Author: Jan Dufek
+ */
+
+#include "ParticleTracker.hpp"
+
+// Particles scored by one task of the thread pool
+static const int PARTICLE_BLOCK = 64;
+
+// Smallest side of a particle box in pixels
+static const float MIN_PARTICLE_SIZE = 4;
+
+// Largest number of grid cells on a side used to group particles
+static const int MAX_GRID_SIDE = 64;
+
+/**
+ * Scores blocks of particles.
+ */
+class EvaluateParticlesInvoker : public ParallelLoopBody {
+public:
+
+    EvaluateParticlesInvoker(ParticleTracker& t, const IntegralCamShift& i) : tracker(t), integrals(i) {
+    }
+
+    virtual void operator()(const Range& range) const {
+        tracker.evaluate(integrals, range);
+    }
+
+private:
+
+    ParticleTracker& tracker;
+    const IntegralCamShift& integrals;
+
+};
+
+ParticleTracker::ParticleTracker(Settings& s) : rng(0x5eed) {
+    settings = &s;
+}
+
+ParticleTracker::~ParticleTracker() {
+}
+
+/**
+ * Spread particles around a window.
+ *
+ * @param window
+ */
+void ParticleTracker::reset(const Rect& window) {
+
+    int count = max(settings->particle_count, 1);
+
+    x.resize(count);
+    y.resize(count);
+    width.resize(count);
+    height.resize(count);
+    score.resize(count);
+    weight.assign(count, 1.f / count);
+
+    inner_left.resize(count);
+    inner_top.resize(count);
+    inner_right.resize(count);
+    inner_bottom.resize(count);
+    outer_left.resize(count);
+    outer_top.resize(count);
+    outer_right.resize(count);
+    outer_bottom.resize(count);
+    inner_mass.resize(count);
+    outer_mass.resize(count);
+
+    float window_width = max((float) window.width, MIN_PARTICLE_SIZE);
+    float window_height = max((float) window.height, MIN_PARTICLE_SIZE);
+
+    for (int i = 0; i < count; i++) {
+        x[i] = window.x + window.width / 2.f + rng.gaussian(settings->particle_position_noise * window_width);
+        y[i] = window.y + window.height / 2.f + rng.gaussian(settings->particle_position_noise * window_height);
+        width[i] = window_width * exp(rng.gaussian(settings->particle_size_noise));
+        height[i] = window_height * exp(rng.gaussian(settings->particle_size_noise));
+    }
+
+    estimate = window;
+    initialized = true;
+}
+
+/**
+ * Move particles to another tracking resolution.
+ *
+ * @param ratio
+ */
+void ParticleTracker::scale(double ratio) {
+
+    for (size_t i = 0; i < x.size(); i++) {
+        x[i] *= ratio;
+        y[i] *= ratio;
+        width[i] = max((float) (width[i] * ratio), MIN_PARTICLE_SIZE);
+        height[i] = max((float) (height[i] * ratio), MIN_PARTICLE_SIZE);
+    }
+
+    estimate = Rect(cvRound(estimate.x * ratio), cvRound(estimate.y * ratio), cvRound(estimate.width * ratio), cvRound(estimate.height * ratio));
+}
+
+/**
+ * Move particles with the image, for example when the camera moved.
+ *
+ * @param shift
+ */
+void ParticleTracker::translate(Point2f shift) {
+
+    for (size_t i = 0; i < x.size(); i++) {
+        x[i] += shift.x;
+        y[i] += shift.y;
+    }
+
+    estimate += Point(cvRound(shift.x), cvRound(shift.y));
+}
+
+/**
+ * Move particles by the expected motion and diffuse them.
+ *
+ * @param motion
+ */
+void ParticleTracker::predict(Point2f motion) {
+
+    for (size_t i = 0; i < x.size(); i++) {
+        x[i] += motion.x + rng.gaussian(settings->particle_position_noise * width[i]);
+        y[i] += motion.y + rng.gaussian(settings->particle_position_noise * height[i]);
+        width[i] = max((float) (width[i] * exp(rng.gaussian(settings->particle_size_noise))), MIN_PARTICLE_SIZE);
+        height[i] = max((float) (height[i] * exp(rng.gaussian(settings->particle_size_noise))), MIN_PARTICLE_SIZE);
+    }
+}
+
+/**
+ * Score blocks of particles. A particle scores by the density of its box
+ * times the emptiness of the ring around it, which is as wide as the box.
+ *
+ * @param integrals integral images of the back projection
+ * @param blocks range of particle blocks
+ */
+void ParticleTracker::evaluate(const IntegralCamShift& integrals, const Range& blocks) {
+
+    Rect region = integrals.get_region();
+    int region_right = region.x + region.width;
+    int region_bottom = region.y + region.height;
+
+    int begin = blocks.start * PARTICLE_BLOCK;
+    int end = min(blocks.end * PARTICLE_BLOCK, (int) x.size());
+
+    for (int i = begin; i < end; i++) {
+
+        float half_width = width[i] / 2;
+        float half_height = height[i] / 2;
+
+        inner_left[i] = min(max((int) (x[i] - half_width), region.x), region_right);
+        inner_right[i] = min(max((int) (x[i] + half_width), region.x), region_right);
+        inner_top[i] = min(max((int) (y[i] - half_height), region.y), region_bottom);
+        inner_bottom[i] = min(max((int) (y[i] + half_height), region.y), region_bottom);
+
+        outer_left[i] = min(max((int) (x[i] - 2 * half_width), region.x), region_right);
+        outer_right[i] = min(max((int) (x[i] + 2 * half_width), region.x), region_right);
+        outer_top[i] = min(max((int) (y[i] - 2 * half_height), region.y), region_bottom);
+        outer_bottom[i] = min(max((int) (y[i] + 2 * half_height), region.y), region_bottom);
+    }
+
+    integrals.masses(&inner_left[begin], &inner_top[begin], &inner_right[begin], &inner_bottom[begin], end - begin, &inner_mass[begin]);
+    integrals.masses(&outer_left[begin], &outer_top[begin], &outer_right[begin], &outer_bottom[begin], end - begin, &outer_mass[begin]);
+
+    for (int i = begin; i < end; i++) {
+
+        float inner_area = max((inner_right[i] - inner_left[i]) * (inner_bottom[i] - inner_top[i]), 1);
+        float outer_area = max((outer_right[i] - outer_left[i]) * (outer_bottom[i] - outer_top[i]), 1);
+        float ring_area = max(outer_area - inner_area, 1.f);
+
+        float inner_density = inner_mass[i] / (255.f * inner_area);
+        float ring_density = (outer_mass[i] - inner_mass[i]) / (255.f * ring_area);
+
+        score[i] = inner_density * (1 - ring_density);
+    }
+}
+
+/**
+ * Turn scores into normalized weights.
+ */
+void ParticleTracker::weigh() {
+
+    float best_score = *max_element(score.begin(), score.end());
+
+    double total = 0;
+    for (size_t i = 0; i < score.size(); i++) {
+        weight[i] = exp(settings->particle_score_gain * (score[i] - best_score));
+        total += weight[i];
+    }
+
+    for (size_t i = 0; i < weight.size(); i++) {
+        weight[i] /= total;
+    }
+}
+
+/**
+ * Bin particle centers on a grid with cells of half the mean particle box,
+ * counting sort by cell.
+ *
+ * @param left left edge of the grid
+ * @param top top edge of the grid
+ * @param cell side of a cell
+ * @param columns
+ * @param rows
+ */
+void ParticleTracker::bin_particles(float& left, float& top, float& cell, int& columns, int& rows) {
+
+    int count = x.size();
+
+    float right = x[0], bottom = y[0];
+    double mean_side = 0;
+
+    left = x[0];
+    top = y[0];
+
+    for (int i = 0; i < count; i++) {
+        left = min(left, x[i]);
+        top = min(top, y[i]);
+        right = max(right, x[i]);
+        bottom = max(bottom, y[i]);
+        mean_side += min(width[i], height[i]);
+    }
+
+    // Widely spread particles get coarser cells
+    cell = max((float) (mean_side / count / 2), MIN_PARTICLE_SIZE / 2);
+    cell = max(cell, max(right - left, bottom - top) / (MAX_GRID_SIDE - 1));
+
+    columns = (int) ((right - left) / cell) + 1;
+    rows = (int) ((bottom - top) / cell) + 1;
+
+    grid_start.assign(columns * rows + 1, 0);
+    grid_particles.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        int c = min((int) ((y[i] - top) / cell), rows - 1) * columns + min((int) ((x[i] - left) / cell), columns - 1);
+        grid_start[c + 1]++;
+    }
+
+    for (int c = 0; c < columns * rows; c++) {
+        grid_start[c + 1] += grid_start[c];
+    }
+
+    vector<int> next(grid_start.begin(), grid_start.end() - 1);
+
+    for (int i = 0; i < count; i++) {
+        int c = min((int) ((y[i] - top) / cell), rows - 1) * columns + min((int) ((x[i] - left) / cell), columns - 1);
+        grid_particles[next[c]++] = i;
+    }
+}
+
+/**
+ * Group weighted particles into modes. Every mode is seeded by the
+ * heaviest particle not yet grouped and takes the particles whose centers
+ * are within half of the seed box. Only the grid cells under the seed box
+ * are searched, so grouping costs about the number of particles instead
+ * of its square.
+ *
+ * @return
+ */
+ParticleResult ParticleTracker::find_modes() {
+
+    int count = x.size();
+
+    float grid_left, grid_top, cell;
+    int columns, rows;
+
+    bin_particles(grid_left, grid_top, cell, columns, rows);
+
+    vector<int> order(count);
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [this](int a, int b) {
+        return weight[a] > weight[b];
+    });
+
+    mode.assign(count, -1);
+
+    vector<double> mode_weight;
+    vector<Vec4d> mode_box;
+    vector<double> mode_score;
+
+    for (int k = 0; k < count; k++) {
+
+        int seed = order[k];
+
+        if (mode[seed] >= 0) {
+            continue;
+        }
+
+        int index = mode_weight.size();
+        float radius_x = width[seed] / 2;
+        float radius_y = height[seed] / 2;
+
+        double total = 0;
+        Vec4d box(0, 0, 0, 0);
+        double mode_total_score = 0;
+
+        int first_column = max((int) ((x[seed] - radius_x - grid_left) / cell), 0);
+        int last_column = min((int) ((x[seed] + radius_x - grid_left) / cell), columns - 1);
+        int first_row = max((int) ((y[seed] - radius_y - grid_top) / cell), 0);
+        int last_row = min((int) ((y[seed] + radius_y - grid_top) / cell), rows - 1);
+
+        for (int row = first_row; row <= last_row; row++) {
+            for (int c = row * columns + first_column; c <= row * columns + last_column; c++) {
+                for (int j = grid_start[c]; j < grid_start[c + 1]; j++) {
+
+                    int i = grid_particles[j];
+
+                    if (mode[i] < 0 && fabs(x[i] - x[seed]) <= radius_x && fabs(y[i] - y[seed]) <= radius_y) {
+                        mode[i] = index;
+                        total += weight[i];
+                        box += Vec4d(x[i], y[i], width[i], height[i]) * (double) weight[i];
+                        mode_total_score += score[i] * weight[i];
+                    }
+                }
+            }
+        }
+
+        mode_weight.push_back(total);
+        mode_box.push_back(box);
+        mode_score.push_back(mode_total_score);
+    }
+
+    ParticleResult result;
+
+    size_t strongest = 0;
+    for (size_t m = 0; m < mode_weight.size(); m++) {
+        if (mode_weight[m] > mode_weight[strongest]) {
+            strongest = m;
+        }
+        if (mode_weight[m] >= settings->particle_mode_min_share) {
+            result.modes++;
+        }
+    }
+
+    double total = max(mode_weight[strongest], 1e-12);
+    Vec4d box = mode_box[strongest] * (1 / total);
+
+    result.window = Rect(cvRound(box[0] - box[2] / 2), cvRound(box[1] - box[3] / 2), cvRound(box[2]), cvRound(box[3]));
+    result.mode_share = mode_weight[strongest];
+    result.confidence = result.mode_share * mode_score[strongest] / total;
+
+    double squared = 0;
+    for (int i = 0; i < count; i++) {
+        squared += (double) weight[i] * weight[i];
+    }
+    result.effective_particles = 1 / squared;
+
+    return result;
+}
+
+/**
+ * Systematic resampling, heavy particles are copied and light ones dropped.
+ */
+void ParticleTracker::resample() {
+
+    int count = x.size();
+
+    vector<float> new_x(count), new_y(count), new_width(count), new_height(count);
+
+    float step = 1.f / count;
+    float position = rng.uniform(0.f, step);
+    float cumulative = weight[0];
+    int source = 0;
+
+    for (int i = 0; i < count; i++) {
+
+        while (position > cumulative && source < count - 1) {
+            source++;
+            cumulative += weight[source];
+        }
+
+        new_x[i] = x[source];
+        new_y[i] = y[source];
+        new_width[i] = width[source];
+        new_height[i] = height[source];
+
+        position += step;
+    }
+
+    x.swap(new_x);
+    y.swap(new_y);
+    width.swap(new_width);
+    height.swap(new_height);
+
+    weight.assign(count, step);
+}
+
+/**
+ * One filter step on the integral images of the current frame.
+ *
+ * @param integrals integral images of the back projection
+ * @param window current search window. Particles are spread around it
+ * again if it does not touch the last estimate, for example after
+ * reacquisition.
+ * @param motion expected motion of the victim since the last frame
+ * @return
+ */
+ParticleResult ParticleTracker::track(const IntegralCamShift& integrals, const Rect& window, Point2f motion) {
+
+    if (!initialized || (int) x.size() != max(settings->particle_count, 1) || (window & estimate).area() == 0) {
+        reset(window);
+    }
+
+    predict(motion);
+
+    int blocks = ((int) x.size() + PARTICLE_BLOCK - 1) / PARTICLE_BLOCK;
+
+    if (blocks > 1) {
+        parallel_for_(Range(0, blocks), EvaluateParticlesInvoker(*this, integrals), blocks);
+    } else {
+        evaluate(integrals, Range(0, blocks));
+    }
+
+    weigh();
+
+    ParticleResult result = find_modes();
+
+    resample();
+
+    estimate = result.window;
+
+    return result;
+}
@@ -0,0 +1,127 @@
+/*
+ * File:   ParticleTracker.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef PARTICLETRACKER_HPP
+#define PARTICLETRACKER_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+#include "IntegralCamShift.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Result of one particle filter step.
+ */
+struct ParticleResult {
+
+    // Window of the strongest mode
+    Rect window;
+
+    // Share of the total weight in the strongest mode, times its score
+    double confidence = 0;
+
+    // Share of the total weight in the strongest mode
+    double mode_share = 0;
+
+    // Number of modes holding at least particle_mode_min_share of the weight
+    int modes = 0;
+
+    // Effective number of particles, 1 / sum of squared weights
+    double effective_particles = 0;
+
+};
+
+/**
+ * Multi-hypothesis tracker on the integral image of the back projection.
+ *
+ * Every particle is a box. It scores by the density of back projection
+ * inside of the box and by how empty the ring of the same size around it
+ * is, so a box on the victim beats both a box on a larger glint and a box
+ * half off the victim. Each score costs two integral lookups, so the cost
+ * grows with particle count and not with pixel count.
+ *
+ * Particles are kept as arrays of coordinates, which lets box clamping,
+ * integral lookups and scoring vectorize across particles. Blocks of
+ * particles are scored on the OpenCV thread pool.
+ *
+ * Weighted particles are grouped into modes around the heaviest particles.
+ * The strongest mode is the estimate, and the split of weight between the
+ * modes is the confidence, so two equally good candidates show as low
+ * confidence instead of a jump.
+ */
+class ParticleTracker {
+public:
+
+    ParticleTracker(Settings&);
+    ParticleTracker(const ParticleTracker& orig) = delete;
+    ParticleTracker& operator=(const ParticleTracker& orig) = delete;
+    virtual ~ParticleTracker();
+
+    ParticleResult track(const IntegralCamShift&, const Rect&, Point2f);
+
+    void reset(const Rect&);
+
+    void scale(double);
+
+    void translate(Point2f);
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    RNG rng;
+
+    // Particle boxes, center and size
+    vector<float> x;
+    vector<float> y;
+    vector<float> width;
+    vector<float> height;
+
+    // Scores and normalized weights
+    vector<float> score;
+    vector<float> weight;
+
+    // Clamped edges of the inner box and of the box with the ring
+    vector<int> inner_left, inner_top, inner_right, inner_bottom;
+    vector<int> outer_left, outer_top, outer_right, outer_bottom;
+
+    // Back projection mass in the boxes
+    vector<int64> inner_mass;
+    vector<int64> outer_mass;
+
+    // Mode of each particle
+    vector<int> mode;
+
+    // Particles binned by their center on a grid, particles of cell c are
+    // grid_particles[grid_start[c]] to grid_particles[grid_start[c + 1] - 1]
+    vector<int> grid_start;
+    vector<int> grid_particles;
+
+    void bin_particles(float&, float&, float&, int&, int&);
+
+    // Window of the strongest mode of the last step
+    Rect estimate;
+
+    bool initialized = false;
+
+    void predict(Point2f);
+
+    void evaluate(const IntegralCamShift&, const Range&);
+
+    void weigh();
+
+    ParticleResult find_modes();
+
+    void resample();
+
+    friend class EvaluateParticlesInvoker;
+
+};
+
+#endif /* PARTICLETRACKER_HPP */
+
@@ -0,0 +1,170 @@
+/*
+ * File:   ResolutionController.cpp
+ * Author: Jan Dufek
+ */
+
+#include "ResolutionController.hpp"
+
+ResolutionController::ResolutionController(Settings& s) {
+    settings = &s;
+}
+
+ResolutionController::~ResolutionController() {
+}
+
+/**
+ * Set up the levels. The search level is the processing resolution, one
+ * level below the source if the source is larger.
+ *
+ * @param source full resolution of the frames
+ * @param reference processing resolution
+ */
+void ResolutionController::set_sizes(Size source, Size reference) {
+
+    source_size = source;
+    reference_size = reference;
+
+    search_level = source_size.height > reference_size.height ? 1 : 0;
+    max_level = search_level + max(settings->adaptive_resolution_levels, 0);
+
+    level_frames.assign(max_level + 1, 0);
+
+    search();
+}
+
+/**
+ * Choose the level for a victim of the given size. The level gets finer as
+ * soon as the victim is too small, but coarser only when the victim is
+ * larger by the margin, so that the level does not flicker.
+ *
+ * @param target_size smaller side of the victim in processing pixels
+ * @return level
+ */
+int ResolutionController::select(double target_size) {
+
+    searching = false;
+
+    double min_size = settings->adaptive_min_target_size;
+
+    while (level > 0 && target_size * get_level_scale(level) < min_size) {
+        level--;
+    }
+
+    while (level < max_level && target_size * get_level_scale(level + 1) >= min_size * settings->adaptive_coarsen_margin) {
+        level++;
+    }
+
+    level_frames[level]++;
+
+    return level;
+}
+
+/**
+ * Go back to the whole frame at the search level.
+ */
+void ResolutionController::search() {
+
+    searching = true;
+
+    level = search_level;
+}
+
+/**
+ * Get the frame of the current level. The source and the processing frame
+ * are shared, coarser levels are averaged down from the processing frame.
+ *
+ * @param source full resolution frame
+ * @param reference frame in processing resolution
+ * @param level_frame
+ */
+void ResolutionController::build(const Mat& source, const Mat& reference, Mat& level_frame) const {
+
+    Size size = get_level_size(level);
+
+    if (size == reference.size()) {
+        level_frame = reference;
+    } else if (size == source.size()) {
+        level_frame = source;
+    } else {
+        resize(reference, level_frame, size, 0, 0, INTER_AREA);
+    }
+}
+
+/**
+ * Ratio of level to processing resolution.
+ *
+ * @param level_index
+ * @return
+ */
+double ResolutionController::get_level_scale(int level_index) const {
+
+    if (level_index < search_level) {
+        return (double) source_size.width / reference_size.width;
+    }
+
+    return 1. / (1 << (level_index - search_level));
+}
+
+/**
+ * Frame size of a level.
+ *
+ * @param level_index
+ * @return
+ */
+Size ResolutionController::get_level_size(int level_index) const {
+
+    if (level_index < search_level) {
+        return source_size;
+    }
+
+    int shift = level_index - search_level;
+
+    return Size(max(reference_size.width >> shift, 1), max(reference_size.height >> shift, 1));
+}
+
+int ResolutionController::get_level() {
+    return level;
+}
+
+/**
+ * Ratio of the current level to processing resolution.
+ *
+ * @return
+ */
+double ResolutionController::get_scale() {
+    return (double) get_level_size(level).width / reference_size.width;
+}
+
+/**
+ * Whether only the region around the victim is processed at the current
+ * level. Only levels finer than the processing resolution are limited to
+ * the region, which is the source level of a source larger than the
+ * processing resolution.
+ *
+ * @return
+ */
+bool ResolutionController::is_region_only() {
+    return !searching && level < search_level;
+}
+
+/**
+ * Print how many frames were tracked at each level.
+ */
+void ResolutionController::print_statistics() {
+
+    long total = 0;
+    for (size_t i = 0; i < level_frames.size(); i++) {
+        total += level_frames[i];
+    }
+
+    if (total == 0) {
+        return;
+    }
+
+    cout << "Tracking levels:";
+    for (size_t i = 0; i < level_frames.size(); i++) {
+        Size size = get_level_size(i);
+        cout << " " << size.width << "x" << size.height << " " << 100. * level_frames[i] / total << "%";
+    }
+    cout << endl;
+}
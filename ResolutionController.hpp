@@ -0,0 +1,84 @@
+/*
+ * File:   ResolutionController.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef RESOLUTIONCONTROLLER_HPP
+#define RESOLUTIONCONTROLLER_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Chooses the tracking resolution per frame from the size of the victim.
+ *
+ * Level 0 is the full resolution of the source frame and every further
+ * level halves it. The coarsest level at which the victim still keeps
+ * adaptive_min_target_size pixels is used, so near and large victims are
+ * tracked on a few lines while distant ones get the full resolution.
+ * Levels finer than the search level, which matches the fixed processing
+ * resolution, only process the region around the victim.
+ *
+ * Without a track the search level is used over the whole frame.
+ */
+class ResolutionController {
+public:
+
+    ResolutionController(Settings&);
+    ResolutionController(const ResolutionController& orig) = delete;
+    ResolutionController& operator=(const ResolutionController& orig) = delete;
+    virtual ~ResolutionController();
+
+    void set_sizes(Size, Size);
+
+    int select(double);
+
+    void search();
+
+    void build(const Mat&, const Mat&, Mat&) const;
+
+    int get_level();
+
+    double get_scale();
+
+    bool is_region_only();
+
+    void print_statistics();
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Size of the full resolution source frame
+    Size source_size;
+
+    // Size of the fixed processing resolution
+    Size reference_size;
+
+    // Current level
+    int level = 0;
+
+    // Finest level processed over the whole frame
+    int search_level = 0;
+
+    // Coarsest level
+    int max_level = 0;
+
+    // No track, so the whole frame is processed at the search level
+    bool searching = true;
+
+    // Frames tracked at each level
+    vector<long> level_frames;
+
+    double get_level_scale(int) const;
+
+    Size get_level_size(int) const;
+
+};
+
+#endif /* RESOLUTIONCONTROLLER_HPP */
+
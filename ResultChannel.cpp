@@ -0,0 +1,221 @@
+/*
+ * File:   ResultChannel.cpp
+ * Author: Jan Dufek
+ */
+
+#include "ResultChannel.hpp"
+
+#include <string.h>
+
+// Attempts to read the newest result before giving up to a fast writer
+static const int READ_ATTEMPTS = 100;
+
+/**
+ * Create channel.
+ *
+ * @param history_size number of recent results kept for history queries
+ */
+ResultChannel::ResultChannel(int history_size) {
+
+    slot_count = max(history_size, 2);
+
+    slots = new Slot[slot_count];
+
+    for (int i = 0; i < slot_count; i++) {
+        slots[i].sequence.store(0, std::memory_order_relaxed);
+        for (int w = 0; w < WORDS; w++) {
+            slots[i].words[w].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    published.store(0, std::memory_order_release);
+}
+
+ResultChannel::~ResultChannel() {
+    delete[] slots;
+}
+
+/**
+ * Publish a result. Only one thread may publish.
+ *
+ * @param result
+ */
+void ResultChannel::publish(const TrackingResult& result) {
+
+    uint64_t number = published.load(std::memory_order_relaxed);
+
+    TrackSnapshot snapshot;
+    memset(&snapshot, 0, sizeof (snapshot));
+
+    snapshot.sequence = number + 1;
+    snapshot.timestamp = result.timestamp;
+    snapshot.frame_number = result.frame_number;
+    snapshot.valid = result.valid;
+    snapshot.x = result.center.x;
+    snapshot.y = result.center.y;
+    snapshot.width = result.size.width;
+    snapshot.height = result.size.height;
+    snapshot.angle = result.angle;
+    snapshot.confidence = (float) result.confidence;
+    snapshot.bearing_valid = result.bearing.valid;
+    snapshot.azimuth = (float) result.bearing.azimuth;
+    snapshot.elevation = (float) result.bearing.elevation;
+
+    uint64_t words[WORDS] = {0};
+    memcpy(words, &snapshot, sizeof (snapshot));
+
+    Slot& slot = slots[number % slot_count];
+
+    slot.sequence.store(2 * number + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (int w = 0; w < WORDS; w++) {
+        slot.words[w].store(words[w], std::memory_order_relaxed);
+    }
+
+    slot.sequence.store(2 * number + 2, std::memory_order_release);
+
+    published.store(number + 1, std::memory_order_release);
+}
+
+/**
+ * Copy one result out of the ring.
+ *
+ * @param number number of the result, from 0
+ * @param snapshot
+ * @return false if the slot holds another result or is being written
+ */
+bool ResultChannel::read(uint64_t number, TrackSnapshot& snapshot) const {
+
+    const Slot& slot = slots[number % slot_count];
+
+    uint64_t before = slot.sequence.load(std::memory_order_acquire);
+
+    if (before != 2 * number + 2) {
+        return false;
+    }
+
+    uint64_t words[WORDS];
+
+    for (int w = 0; w < WORDS; w++) {
+        words[w] = slot.words[w].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (slot.sequence.load(std::memory_order_relaxed) != before) {
+        return false;
+    }
+
+    memcpy(&snapshot, words, sizeof (snapshot));
+
+    return true;
+}
+
+/**
+ * Get the newest consistent result.
+ *
+ * @param snapshot
+ * @return false if nothing was published yet
+ */
+bool ResultChannel::latest(TrackSnapshot& snapshot) const {
+
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+
+        uint64_t count = published.load(std::memory_order_acquire);
+
+        if (count == 0) {
+            return false;
+        }
+
+        if (read(count - 1, snapshot)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Get recent results, newest first. Results overwritten while reading end
+ * the history early.
+ *
+ * @param snapshots output array
+ * @param max_count size of the output array
+ * @return number of results written
+ */
+int ResultChannel::history(TrackSnapshot * snapshots, int max_count) const {
+
+    uint64_t count = published.load(std::memory_order_acquire);
+
+    // The oldest slot may be overwritten by the next publication
+    uint64_t available = min(count, (uint64_t) (slot_count - 1));
+    int wanted = (int) min((uint64_t) max(max_count, 0), available);
+
+    int written = 0;
+
+    for (int i = 0; i < wanted; i++) {
+
+        if (!read(count - 1 - i, snapshots[written])) {
+            break;
+        }
+
+        written++;
+    }
+
+    return written;
+}
+
+/**
+ * Velocity of the victim from the valid results of a recent time window.
+ *
+ * @param pixels_per_second output velocity in pixels of the pushed frame
+ * @param window window length in nanoseconds
+ * @return false if fewer than two valid results fall into the window
+ */
+bool ResultChannel::velocity(Point2f& pixels_per_second, int64_t window) const {
+
+    TrackSnapshot newest;
+    TrackSnapshot oldest;
+    bool found_newest = false;
+    bool found_oldest = false;
+
+    uint64_t count = published.load(std::memory_order_acquire);
+    uint64_t available = min(count, (uint64_t) (slot_count - 1));
+
+    for (uint64_t i = 0; i < available; i++) {
+
+        TrackSnapshot snapshot;
+
+        if (!read(count - 1 - i, snapshot)) {
+            break;
+        }
+
+        if (!snapshot.valid) {
+            continue;
+        }
+
+        if (!found_newest) {
+            newest = snapshot;
+            found_newest = true;
+            continue;
+        }
+
+        if (newest.timestamp - snapshot.timestamp > window) {
+            break;
+        }
+
+        oldest = snapshot;
+        found_oldest = true;
+    }
+
+    if (!found_oldest || newest.timestamp <= oldest.timestamp) {
+        return false;
+    }
+
+    double seconds = (newest.timestamp - oldest.timestamp) * 1e-9;
+
+    pixels_per_second = Point2f((float) ((newest.x - oldest.x) / seconds), (float) ((newest.y - oldest.y) / seconds));
+
+    return true;
+}
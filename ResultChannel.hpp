@@ -0,0 +1,103 @@
+/*
+ * File:   ResultChannel.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef RESULTCHANNEL_HPP
+#define RESULTCHANNEL_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+#include "opencv2/opencv.hpp"
+#include "TrackingResult.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Plain copy of a tracking result as seen by readers on other threads.
+ */
+struct TrackSnapshot {
+
+    // Number of the publication, starting at 1
+    uint64_t sequence;
+
+    // Monotonic time the frame arrived in nanoseconds
+    int64_t timestamp;
+
+    int64_t frame_number;
+
+    int32_t valid;
+
+    // Center and size in pixels of the pushed frame
+    float x;
+    float y;
+    float width;
+    float height;
+
+    // Orientation in degrees
+    float angle;
+
+    float confidence;
+
+    // Bearing in degrees, valid only if bearing_valid is set
+    int32_t bearing_valid;
+    float azimuth;
+    float elevation;
+
+};
+
+/**
+ * Lock-free channel of tracking results from the vision thread to any
+ * number of readers, such as a control loop or telemetry.
+ *
+ * Results go into a ring of recent snapshots. Every slot is guarded by a
+ * sequence lock: its counter is odd while the single writer fills it.
+ * Readers copy the slot and accept the copy only if the counter was even
+ * and did not change meanwhile. The writer never waits and readers never
+ * block it. A reader only retries if it raced with a write, which takes a
+ * few hundred nanoseconds once per frame.
+ */
+class ResultChannel {
+public:
+
+    ResultChannel(int);
+    ResultChannel(const ResultChannel& orig) = delete;
+    ResultChannel& operator=(const ResultChannel& orig) = delete;
+    virtual ~ResultChannel();
+
+    void publish(const TrackingResult&);
+
+    bool latest(TrackSnapshot&) const;
+
+    int history(TrackSnapshot*, int) const;
+
+    bool velocity(Point2f&, int64_t) const;
+
+private:
+
+    static_assert(std::is_trivially_copyable<TrackSnapshot>::value, "Snapshots are copied word by word");
+
+    // Snapshot stored as relaxed atomic words, so torn reads are detected
+    // instead of being undefined behaviour
+    static const int WORDS = (sizeof (TrackSnapshot) + sizeof (uint64_t) - 1) / sizeof (uint64_t);
+
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> words[WORDS];
+    };
+
+    // Ring of recent results
+    Slot * slots;
+    int slot_count;
+
+    // Number of results published so far
+    std::atomic<uint64_t> published;
+
+    bool read(uint64_t, TrackSnapshot&) const;
+
+};
+
+#endif /* RESULTCHANNEL_HPP */
+
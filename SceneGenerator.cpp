@@ -0,0 +1,300 @@
+/*
+ * File:   SceneGenerator.cpp
+ * Author: Jan Dufek
+ */
+
+#include "SceneGenerator.hpp"
+#include "OutputVideo.hpp"
+
+// Jacket colors in BGR
+static const Scalar RED_JACKET(40, 40, 210);
+static const Scalar YELLOW_JACKET(40, 210, 230);
+
+// Sea color at the bottom of the frame and in the haze at the horizon
+static const Vec3f SEA_NEAR(90, 60, 20);
+static const Vec3f SEA_FAR(150, 125, 95);
+
+// Sky color at the horizon and at the top of the frame
+static const Vec3f SKY_HORIZON(230, 205, 180);
+static const Vec3f SKY_TOP(190, 140, 90);
+
+// Seconds a victim stays under water when diving
+static const double DIVE_SECONDS = 1;
+
+SceneGenerator::SceneGenerator(Settings& s) {
+
+    settings = &s;
+
+    fps = 0;
+    horizon_left = 0;
+    horizon_right = 0;
+
+}
+
+SceneGenerator::~SceneGenerator() {
+}
+
+/**
+ * Draw waves and target paths from the seed.
+ *
+ * @param target_count
+ */
+void SceneGenerator::create_scene(int target_count) {
+
+    rng = RNG(settings->scene_seed);
+
+    // Horizon in the upper third, tilted by a few rows like from a rolling boat
+    double horizon = size.height * rng.uniform(0.2, 0.33);
+    double tilt = size.height * rng.uniform(-0.03, 0.03);
+    horizon_left = horizon - tilt;
+    horizon_right = horizon + tilt;
+
+    // Long swell first, then shorter and weaker chop
+    waves.clear();
+    for (int i = 0; i < settings->scene_waves; i++) {
+
+        double length = size.width / (2. + 3 * i + rng.uniform(0., 2.));
+        double direction = rng.uniform(-0.6, 0.6);
+
+        Wave wave;
+        wave.amplitude = 1. / (1 + i);
+        wave.frequency_x = 2 * CV_PI / length * sin(direction);
+        wave.frequency_y = 2 * CV_PI / length * cos(direction);
+        wave.speed = 2 * CV_PI * rng.uniform(0.2, 0.8);
+        wave.phase = rng.uniform(0., 2 * CV_PI);
+        waves.push_back(wave);
+    }
+
+    // Column phase does not change between frames
+    column_sine.assign(waves.size(), vector<float>(size.width));
+    column_cosine.assign(waves.size(), vector<float>(size.width));
+    row_sine.assign(waves.size(), vector<float>(size.height));
+    row_cosine.assign(waves.size(), vector<float>(size.height));
+
+    for (size_t i = 0; i < waves.size(); i++) {
+        for (int x = 0; x < size.width; x++) {
+            column_sine[i][x] = sin(waves[i].frequency_x * x);
+            column_cosine[i][x] = cos(waves[i].frequency_x * x);
+        }
+    }
+
+    targets.clear();
+    for (int i = 0; i < target_count; i++) {
+
+        Target target;
+
+        // The preset color first, then alternating
+        bool red = (settings->color_preset == COLOR_PRESET_RED) == (i % 2 == 0);
+        target.color = red ? RED_JACKET : YELLOW_JACKET;
+
+        target.center = Point2d(rng.uniform(0.2, 0.8), rng.uniform(0.35, 0.75));
+        target.extent = Point2d(rng.uniform(0.05, 0.2), rng.uniform(0.05, 0.2));
+        target.angular_speed = Point2d(2 * CV_PI / rng.uniform(15., 40.), 2 * CV_PI / rng.uniform(15., 40.));
+        target.phase = Point2d(rng.uniform(0., 2 * CV_PI), rng.uniform(0., 2 * CV_PI));
+        target.dive_period = rng.uniform(15., 30.);
+        target.dive_phase = rng.uniform(0., target.dive_period);
+
+        targets.push_back(target);
+    }
+}
+
+/**
+ * Horizon row at a column.
+ *
+ * @param x
+ * @return
+ */
+double SceneGenerator::horizon_at(double x) const {
+    return horizon_left + (horizon_right - horizon_left) * x / max(size.width - 1, 1);
+}
+
+/**
+ * Render sky and water at a time.
+ *
+ * @param frame
+ * @param time seconds
+ */
+void SceneGenerator::render_water(Mat& frame, double time) {
+
+    double horizon = (horizon_left + horizon_right) / 2;
+    double total_amplitude = 0;
+    for (size_t i = 0; i < waves.size(); i++) {
+        total_amplitude += waves[i].amplitude;
+    }
+
+    // Rows farther away cover more water, so waves get denser toward the horizon
+    for (int y = 0; y < size.height; y++) {
+
+        double depth = max((y - horizon) / (size.height - horizon), 0.02);
+        double distance = size.height / depth;
+
+        for (size_t i = 0; i < waves.size(); i++) {
+            double phase = waves[i].frequency_y * distance - waves[i].speed * time + waves[i].phase;
+            row_sine[i][y] = sin(phase);
+            row_cosine[i][y] = cos(phase);
+        }
+    }
+
+    float glint_level = 0.75 * total_amplitude;
+
+    for (int y = 0; y < size.height; y++) {
+
+        Vec3b * row = frame.ptr<Vec3b>(y);
+
+        double depth = min(max((y - horizon) / (size.height - horizon), 0.), 1.);
+
+        // Waves fade into the haze
+        float contrast = 0.3 * sqrt(depth) / total_amplitude;
+
+        Vec3f sea = SEA_FAR + (SEA_NEAR - SEA_FAR) * sqrt(depth);
+
+        for (int x = 0; x < size.width; x++) {
+
+            double horizon_row = horizon_at(x);
+
+            if (y < horizon_row) {
+                float height = 1 - y / max(horizon_row, 1.);
+                Vec3f sky = SKY_HORIZON + (SKY_TOP - SKY_HORIZON) * height;
+                row[x] = Vec3b(saturate_cast<uchar> (sky[0]), saturate_cast<uchar> (sky[1]), saturate_cast<uchar> (sky[2]));
+                continue;
+            }
+
+            float height = 0;
+            for (size_t i = 0; i < waves.size(); i++) {
+                height += waves[i].amplitude * (column_sine[i][x] * row_cosine[i][y] + column_cosine[i][x] * row_sine[i][y]);
+            }
+
+            Vec3f color = sea * (1 + contrast * height);
+
+            // Crests reflect the sky
+            if (height > glint_level) {
+                float glint = (float) min((height - glint_level) / (total_amplitude - glint_level) * 2, 1.);
+                color += (Vec3f(255, 255, 255) - color) * glint;
+            }
+
+            row[x] = Vec3b(saturate_cast<uchar> (color[0]), saturate_cast<uchar> (color[1]), saturate_cast<uchar> (color[2]));
+        }
+    }
+}
+
+/**
+ * Render one victim at a time.
+ *
+ * @param frame
+ * @param target
+ * @param time seconds
+ * @param box ground truth
+ * @return whether the victim is visible
+ */
+bool SceneGenerator::render_target(Mat& frame, const Target& target, double time, RotatedRect& box) {
+
+    double u = target.center.x + target.extent.x * sin(target.angular_speed.x * time + target.phase.x);
+    double v = target.center.y + target.extent.y * sin(target.angular_speed.y * time + target.phase.y);
+
+    double x = u * size.width;
+    double horizon_row = horizon_at(x);
+    double y = horizon_row + v * (size.height - horizon_row);
+
+    // Perspective size and bobbing
+    double width = settings->scene_target_size * size.height * v * (1 + 0.1 * sin(2 * CV_PI * 0.5 * time + target.phase.x));
+    float angle = 20 * sin(2 * CV_PI * time / 7 + target.phase.y);
+
+    box = RotatedRect(Point2f(x, y), Size2f(width, width * 0.6), angle);
+
+    bool under_water = fmod(time + target.dive_phase, target.dive_period) < DIVE_SECONDS;
+    bool in_frame = x >= 0 && x < size.width && y >= 0 && y < size.height;
+
+    if (under_water || !in_frame || width < 1) {
+        return false;
+    }
+
+    ellipse(frame, box, target.color, -1, LINE_AA);
+
+    // Darker rim and a lit spot make the jacket less flat
+    ellipse(frame, box, target.color * 0.6, max(cvRound(width / 20), 1), LINE_AA);
+    circle(frame, Point(cvRound(x - width * 0.15), cvRound(y - width * 0.1)), max(cvRound(width / 10), 1), target.color * 0.5 + Scalar::all(120), -1, LINE_AA);
+
+    return true;
+}
+
+/**
+ * Generate a scene.
+ *
+ * @param output_name file name without extension
+ * @param frame_size
+ * @param frame_rate
+ * @param seconds
+ * @param target_count
+ * @return 0 on success, -1 if the output cannot be written
+ */
+int SceneGenerator::run(const string& output_name, Size frame_size, double frame_rate, double seconds, int target_count) {
+
+    size = frame_size;
+    fps = frame_rate;
+
+    create_scene(target_count);
+
+    VideoWriter video_writer;
+    ofstream raw_file;
+
+    if (settings->scene_raw_frames) {
+        raw_file.open((output_name + ".bgr").c_str(), ios::binary);
+        if (!raw_file.is_open()) {
+            cout << "Cannot open " << output_name << ".bgr for write." << endl;
+            return -1;
+        }
+    } else {
+        OutputVideo output_video(fps, size, output_name);
+        video_writer = output_video.get_video_writer();
+        if (!video_writer.isOpened()) {
+            return -1;
+        }
+    }
+
+    ofstream truth_file((output_name + ".truth").c_str());
+
+    if (!truth_file.is_open()) {
+        cout << "Cannot open " << output_name << ".truth for write." << endl;
+        return -1;
+    }
+
+    truth_file << "# EMILY synthetic scene" << endl;
+    truth_file << "size " << size.width << " " << size.height << endl;
+    truth_file << "fps " << fps << endl;
+    truth_file << "targets " << target_count << endl;
+    truth_file << "seed " << settings->scene_seed << endl;
+    truth_file << "horizon " << horizon_left << " " << horizon_right << endl;
+    truth_file << "# frame target visible x y width height angle" << endl;
+
+    Mat frame(size, CV_8UC3);
+
+    int64 frames = (int64) (seconds * fps);
+    int64 start_ticks = getTickCount();
+
+    for (int64 frame_number = 0; frame_number < frames; frame_number++) {
+
+        double time = frame_number / fps;
+
+        render_water(frame, time);
+
+        for (size_t i = 0; i < targets.size(); i++) {
+
+            RotatedRect box;
+            bool visible = render_target(frame, targets[i], time, box);
+
+            truth_file << frame_number << " " << i << " " << visible << " " << box.center.x << " " << box.center.y << " " << box.size.width << " " << box.size.height << " " << box.angle << "\n";
+        }
+
+        if (settings->scene_raw_frames) {
+            raw_file.write((const char *) frame.data, frame.total() * frame.elemSize());
+        } else {
+            video_writer << frame;
+        }
+    }
+
+    double elapsed = (getTickCount() - start_ticks) / getTickFrequency();
+
+    cout << "Generated " << frames << " frames of " << size.width << "x" << size.height << " with " << target_count << " targets in " << elapsed << " s" << endl;
+
+    return 0;
+}
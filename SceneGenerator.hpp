@@ -0,0 +1,106 @@
+/*
+ * File:   SceneGenerator.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef SCENEGENERATOR_HPP
+#define SCENEGENERATOR_HPP
+
+#include <stdint.h>
+#include <fstream>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Procedural sea scenes with exact ground truth for benchmarks.
+ *
+ * Water is a sum of travelling waves under a sky with a slightly tilted
+ * horizon. Wave crests catch glint, and contrast and wave size fade
+ * towards the horizon. Victims are red or yellow jackets moving on
+ * scripted Lissajous paths. They get smaller with distance, bob and dive
+ * under the waves now and then. Every scene is reproducible from its seed.
+ *
+ * Frames are written as DIVX video or as raw BGR frames (.bgr, readable by
+ * ffmpeg -f rawvideo -pix_fmt bgr24). The ground truth (.truth) has one
+ * line per frame and target:
+ *
+ *     frame target visible x y width height angle
+ *
+ * Coordinates are in pixels of the generated frames.
+ */
+class SceneGenerator {
+public:
+
+    SceneGenerator(Settings&);
+    SceneGenerator(const SceneGenerator& orig) = delete;
+    SceneGenerator& operator=(const SceneGenerator& orig) = delete;
+    virtual ~SceneGenerator();
+
+    int run(const string&, Size, double, double, int);
+
+private:
+
+    /**
+     * Travelling wave with separable phase.
+     */
+    struct Wave {
+        double amplitude;
+        double frequency_x;
+        double frequency_y;
+        double speed;
+        double phase;
+    };
+
+    /**
+     * Scripted path of one victim in sea coordinates. Horizontal position
+     * runs from 0 to 1 across the frame, depth from 0 at the horizon to 1
+     * at the bottom of the frame.
+     */
+    struct Target {
+        Scalar color;
+        Point2d center;
+        Point2d extent;
+        Point2d angular_speed;
+        Point2d phase;
+        double dive_period;
+        double dive_phase;
+    };
+
+    // Program settings
+    Settings * settings;
+
+    // Random generator of the scene
+    RNG rng;
+
+    Size size;
+    double fps;
+
+    // Horizon row at the left and right edge
+    double horizon_left;
+    double horizon_right;
+
+    vector<Wave> waves;
+
+    vector<Target> targets;
+
+    // Per wave sine and cosine of the row and column phase
+    vector<vector<float> > row_sine;
+    vector<vector<float> > row_cosine;
+    vector<vector<float> > column_sine;
+    vector<vector<float> > column_cosine;
+
+    void create_scene(int);
+
+    double horizon_at(double) const;
+
+    void render_water(Mat&, double);
+
+    bool render_target(Mat&, const Target&, double, RotatedRect&);
+
+};
+
+#endif /* SCENEGENERATOR_HPP */
+
@@ -1 +1,11 @@
-#include "Settings.hpp"
\ No newline at end of file
+#include "Settings.hpp"
+
+// Constants fixed by the build profile, see BuildProfile.hpp
+
+#ifdef PROFILE_BLUR_KERNEL_SIZE
+constexpr int Settings::blur_kernel_size;
+#endif
+
+#ifdef PROFILE_BGR_LOOKUP_TABLE
+constexpr bool Settings::bgr_lookup_table;
+#endif
@@ -2,10 +2,30 @@
 #define SETTINGS_HPP
 
 #include "opencv2/opencv.hpp"
+#include "BuildProfile.hpp"
 
 using namespace std;
 using namespace cv;
 
+// What is recorded for debriefing
+enum RecordingMode {
+
+    // Re-encode every processed frame with the overlay burnt in
+    RECORDING_ANNOTATED,
+
+    // Write only the track sidecar
+    RECORDING_TRACK,
+
+    // Write the track sidecar and keep the clean source stream
+    RECORDING_SOURCE
+};
+
+// Color of the life jacket
+enum ColorPreset {
+    COLOR_PRESET_RED,
+    COLOR_PRESET_YELLOW
+};
+
 class Settings {
 public:
     
@@ -39,6 +59,9 @@ public:
     Mat camera_distortion_vector = (Mat_<double>(1, 5) <<
             5.4296267484343998e-02, -5.9413030935709088e-01, 0., 0., 1.9565543630464968e+00);
 
+    // Resolution the calibration data was computed at
+    Size camera_calibration_size = Size(1600, 1200);
+
     // Inogeni
     ////////////////////////////////////////////////////////////////////////////////
 
@@ -75,6 +98,47 @@ public:
 //    int saturation_min = 10;
 //    int value_min = 10;
     
+    ////////////////////////////////////////////////////////////////////////////////
+    // Shared memory frame server
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Read frames published by a frame server (started with --serve) instead
+    // of opening video_capture_source
+    bool use_frame_server = false;
+
+    // Name of the POSIX shared memory with frames
+    string shared_frames_name = "/emily_tracker_frames";
+
+    // Number of frames kept in shared memory
+    int shared_frames_slots = 4;
+
+    // Time to wait for a new frame from the frame server
+    int shared_frames_timeout_ms = 1000;
+
+    // Time to wait at startup for the frame server to create the shared
+    // memory before giving up
+    int shared_frames_attach_seconds = 30;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Stream reconnection
+    ////////////////////////////////////////////////////////////////////////////
+
+    // A source without frames for this long is down. Files end, streams and
+    // cameras are reopened.
+    double stream_stall_seconds = 2;
+
+    // Delay before the first reopen, doubled after every failed attempt
+    int stream_reconnect_initial_ms = 250;
+
+    // Longest delay between reopen attempts
+    int stream_reconnect_max_ms = 8000;
+
+    // Give up after this long without frames, 0 to keep trying
+    double stream_max_outage_seconds = 0;
+
+    // Sleep after a read without frame before reading again
+    int stream_empty_read_sleep_ms = 10;
+
     ////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////////
     // Algorithm Variable parameters
@@ -96,7 +160,11 @@ public:
     int value_max = 255;
 
     // Gaussian blur kernel size
+#ifdef PROFILE_BLUR_KERNEL_SIZE
+    static constexpr int blur_kernel_size = PROFILE_BLUR_KERNEL_SIZE;
+#else
     int blur_kernel_size = 21;
+#endif
 
     // Erode size
     int erode_size = 2;
@@ -107,6 +175,329 @@ public:
     // EMILY location history size to estimate heading
     const int EMILY_LOCATION_HISTORY_SIZE = 50;
 
+    ////////////////////////////////////////////////////////////////////////////////
+    // Pipeline Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Run the per-frame image pipeline in horizontal bands on the thread pool.
+    // If disabled, the whole frame is processed as one band.
+    bool tiled_pipeline = true;
+
+    // Target working set of one band in bytes. It should fit into L2 cache.
+    int pipeline_band_bytes = 256 * 1024;
+
+    // Print pipeline time for 1 to N cores on the first frame
+    bool report_pipeline_scaling = false;
+
+    // Project blurred BGR pixels through a quantized BGR to probability
+    // table instead of converting them to HSV
+#ifdef PROFILE_BGR_LOOKUP_TABLE
+    static constexpr bool bgr_lookup_table = PROFILE_BGR_LOOKUP_TABLE;
+#else
+    bool bgr_lookup_table = false;
+#endif
+
+    // Bits per channel of the BGR table, 5 is 32^3 and 6 is 64^3 entries
+    int lookup_table_bits = 5;
+
+    // Change of a hue probability, out of 255, that the BGR table follows
+    // while the color model adapts. Smaller changes keep the table as is.
+    int lookup_table_tolerance = 4;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Tracking Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Use CamShift on integral images instead of cv::CamShift
+    bool integral_camshift = true;
+
+    // Search the whole frame for blobs of back projection when the track is lost
+    bool blob_reacquisition = true;
+
+    // Back projection threshold for blob detection
+    int blob_threshold = 64;
+
+    // Track is considered lost below this confidence
+    double lost_confidence = 0.02;
+
+    // Number of recent results kept for readers on other threads
+    int result_history_size = 64;
+
+    // Value equalization, CamShift mean shift steps, size and orientation
+    // in integer arithmetic. This is not a float free tracker: the hue
+    // histogram stays float, moments are 64-bit and mass, confidence and
+    // the returned box are converted to floating point. Box size is exact
+    // to 1/256 pixel, angle to 0.01 degree, the next search window to 1 pixel.
+    bool integer_tracking = false;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Particle Tracking Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Seed CamShift from the strongest mode of a particle filter scored on
+    // the integral images, and take the confidence from the split of the
+    // particle weight between modes
+    bool particle_tracking = false;
+
+    // Number of particles
+    int particle_count = 256;
+
+    // Standard deviation of the position noise as a fraction of the box size
+    double particle_position_noise = 0.1;
+
+    // Standard deviation of the log of the size change per frame
+    double particle_size_noise = 0.05;
+
+    // Sharpness of the weights, the weight ratio of two particles is
+    // exp(gain * score difference)
+    double particle_score_gain = 20;
+
+    // Share of the particle weight a mode needs to count as a hypothesis
+    double particle_mode_min_share = 0.1;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Color Adaptation Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Jacket color the tracker starts with
+    ColorPreset color_preset = COLOR_PRESET_RED;
+
+    // Follow slow changes of the jacket hue caused by sun angle and spray
+    bool color_adaptation = true;
+
+    // Weight of a new observation in the blended histogram
+    double color_adaptation_rate = 0.05;
+
+    // Only tracks at least this confident are learned from
+    double color_adaptation_min_confidence = 0.3;
+
+    // Minimum number of thresholded pixels inside of the tracking box
+    int color_adaptation_min_pixels = 64;
+
+    // Bhattacharyya distance from the current model above which an
+    // observation is ignored
+    double color_adaptation_max_distance = 0.5;
+
+    // Number of ignored observations in a row after which the model is
+    // rolled back to the base
+    int color_adaptation_max_rejections = 30;
+
+    // Bhattacharyya distance from the base model above which the model is
+    // rolled back to the base
+    double color_drift_limit = 0.6;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Change Detection Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Skip processing of frames that did not change since the last processed frame
+    bool change_detection = true;
+
+    // Width of the grayscale thumbnail compared between frames
+    int change_thumbnail_width = 32;
+
+    // Mean absolute thumbnail difference in gray levels below which the
+    // previous tracking result is reused
+    double change_static_threshold = 1.0;
+
+    // Largest absolute difference of one thumbnail cell in gray levels
+    // above which the frame is not static, even if the mean is small. One
+    // cell covers about 60 x 60 pixels of a 1920 wide frame, so a moving
+    // victim shows up in it while sensor noise averages out.
+    double change_cell_threshold = 4.0;
+
+    // Mean absolute thumbnail difference below which only the region around
+    // the victim is processed. No motion is estimated, the region is large
+    // enough for the search window to follow.
+    double change_small_threshold = 6.0;
+
+    // Minimum margin around the search window processed for small changes
+    int change_region_margin = 64;
+
+    // Process the whole frame at least this often
+    int change_full_frame_interval = 30;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Horizon Detection Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Process only the water below the horizon
+    bool horizon_detection = false;
+
+    // Estimate the horizon every this many processed frames
+    int horizon_interval = 5;
+
+    // Width of the grayscale thumbnail the horizon is fitted on
+    int horizon_thumbnail_width = 160;
+
+    // Minimum vertical Sobel response of a horizon candidate
+    int horizon_min_gradient = 40;
+
+    // Horizon tilted more than this in degrees is rejected
+    double horizon_max_tilt = 20;
+
+    // Fraction of thumbnail columns that have to agree with the line
+    double horizon_min_inliers = 0.5;
+
+    // Rows above the horizon still processed, as a fraction of frame
+    // height, for victims near the horizon and roll between estimates
+    double horizon_margin = 0.05;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Ego-motion Compensation Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Move the search window by the global image shift caused by pitch and
+    // roll of the boat before CamShift
+    bool ego_motion_compensation = false;
+
+    // Width of the grayscale thumbnail the shift is estimated on
+    int ego_motion_thumbnail_width = 128;
+
+    // Minimum phase correlation peak of an accepted shift
+    double ego_motion_min_response = 0.1;
+
+    // Largest accepted shift as a fraction of frame width
+    double ego_motion_max_shift = 0.25;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Adaptive Resolution Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Choose the tracking resolution per frame from the size of the victim.
+    // Full input resolution is then used only around a small victim.
+    bool adaptive_resolution = false;
+
+    // Number of halvings of the processing resolution for large victims
+    int adaptive_resolution_levels = 3;
+
+    // Smaller side of the victim in pixels kept at the chosen resolution
+    int adaptive_min_target_size = 24;
+
+    // A coarser resolution is used only once the victim is this many times
+    // larger than the minimum there
+    double adaptive_coarsen_margin = 1.5;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Camera Model Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Compute bearing and angular size of the victim from the calibration
+    // data. Only enable it for the camera the calibration was made with,
+    // sources of another aspect ratio are rejected but the same aspect
+    // ratio from another lens is not detected.
+    bool compute_bearing = false;
+
+    // Remove lens distortion from the whole frame before processing. Only
+    // needed for display, bearing undistorts the tracked points alone.
+    bool undistort_frame = false;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Recording Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Files are referenced and network streams copied without re-encoding.
+    // Overlays are rendered afterwards with --render.
+    RecordingMode recording_mode = RECORDING_SOURCE;
+
+    // Length of a copied stream searched by --render for the first recorded
+    // frame
+    double overlay_anchor_search_seconds = 30;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Tracing Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Record a timeline of pipeline stages, written as Chrome trace JSON next
+    // to the output on exit or on SIGUSR1
+    bool tracing = false;
+
+    // Events kept per thread, later events are dropped
+    int trace_buffer_events = 1 << 16;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Thread Placement Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Cores of each thread role as a list like "0" or "2-3", empty to leave
+    // the placement to the scheduler. The OpenCV pool runs on the
+    // processing cores.
+    string capture_cores = "";
+    string processing_cores = "";
+    string io_cores = "";
+
+    // SCHED_FIFO priority 1-99 of each role, 0 for normal scheduling. Needs
+    // CAP_SYS_NICE or an rtprio limit.
+    int capture_realtime_priority = 0;
+    int processing_realtime_priority = 0;
+    int io_realtime_priority = 0;
+
+    // Nice value of each role with normal scheduling, negative values need
+    // CAP_SYS_NICE
+    int capture_nice = 0;
+    int processing_nice = 0;
+    int io_nice = 0;
+
+    // Size of the OpenCV thread pool, 0 for the OpenCV default
+    int opencv_threads = 0;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Latency Measurement Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Read the stamps of a synthetic source started with --latency-source
+    // and report frame age at the published result on exit
+    bool latency_probe = false;
+
+    // Frame size and rate of the synthetic source
+    Size latency_frame_size = Size(1280, 720);
+    double latency_fps = 30;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Scene Generator Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Write raw BGR frames instead of video with --generate
+    bool scene_raw_frames = false;
+
+    // Seed of the horizon, waves and victim paths
+    int scene_seed = 1;
+
+    // Number of travelling waves
+    int scene_waves = 6;
+
+    // Jacket width relative to the frame height at the bottom of the frame
+    double scene_target_size = 0.08;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Soak Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Simulated mission time of one search leg, a new tracker is created for
+    // every leg by --soak
+    double soak_leg_minutes = 30;
+
+    // Legs after which resident memory is taken as the baseline
+    int soak_warmup_legs = 2;
+
+    // Allowed growth of resident memory over the baseline in megabytes
+    double soak_rss_tolerance_mb = 8;
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Chunked Processing Parameters
+    ////////////////////////////////////////////////////////////////////////////////
+
+    // Chunks per worker process, more chunks balance uneven processing load
+    int chunks_per_worker = 4;
+
+    // Frames before the chunk tracked only to acquire the victim. They
+    // overlap the end of the previous chunk and are used for stitching.
+    double chunk_warmup_seconds = 10;
+
+    // Two tracks agree if their centers are closer than this fraction of the
+    // larger side of the box
+    double chunk_stitch_distance = 0.5;
+
     ////////////////////////////////////////////////////////////////////////////////
     // GUI Parameters
     ////////////////////////////////////////////////////////////////////////////////
@@ -130,7 +521,7 @@ public:
     // Input will be resized to this number of lines to speed up the processing
     //const int PROCESSING_VIDEO_HEIGHT_LIMIT = 640; // MOD webcam resolution
     // Higher resolution will be better if EMILY is in the distance
-    const int PROCESSING_VIDEO_HEIGHT_LIMIT = 1200;
+    const int PROCESSING_VIDEO_HEIGHT_LIMIT = PROFILE_PROCESSING_HEIGHT_LIMIT;
 
     // Blob size restrictions. Blobs outside of this range will be ignored.
     const int MIN_BLOB_AREA = 1 * 1;
@@ -0,0 +1,418 @@
+/*
+ * File:   SharedFrameRing.cpp
+ * Author: Jan Dufek
+ */
+
+#include "SharedFrameRing.hpp"
+
+#include <atomic>
+#include <new>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Identifies a ring and its layout version
+static const uint32_t RING_MAGIC = 0x454d4c31;
+
+// Slots start on cache line boundaries
+static const size_t SLOT_ALIGNMENT = 64;
+
+// Retry delay of a consumer that found the newest slot being overwritten
+static const useconds_t OVERWRITE_RETRY_US = 100;
+
+/**
+ * Monotonic time in nanoseconds.
+ *
+ * @return
+ */
+static int64_t monotonic_now() {
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * Layout of the beginning of the shared memory. Written once by the server
+ * before any frame is published.
+ */
+struct SharedFrameHeader {
+
+    uint32_t magic;
+
+    int32_t width;
+    int32_t height;
+    int32_t type;
+
+    // Bytes per frame row
+    uint64_t step;
+
+    uint32_t slot_count;
+
+    // Bytes per slot including slot header
+    uint64_t slot_bytes;
+
+    // Frame rate of the source
+    double fps;
+
+    // Number of frames published so far
+    std::atomic<uint64_t> published;
+
+};
+
+/**
+ * Header of every slot, followed by frame data.
+ */
+struct SharedFrameSlot {
+
+    // Twice the frame number plus one while written, plus two when complete
+    std::atomic<uint64_t> sequence;
+
+    // Monotonic time of publication in nanoseconds
+    int64_t timestamp;
+
+};
+
+/**
+ * Round up to slot alignment.
+ *
+ * @param bytes
+ * @return
+ */
+static size_t align_slot(size_t bytes) {
+    return (bytes + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+}
+
+SharedFrameRing::SharedFrameRing() {
+
+    mapping = MAP_FAILED;
+    mapping_bytes = 0;
+    owner = false;
+    header = NULL;
+    write_frame_number = 0;
+    read_frame_number = 0;
+
+}
+
+SharedFrameRing::~SharedFrameRing() {
+    close();
+}
+
+/**
+ * Create the ring as the frame server. An existing ring of the same name
+ * is replaced.
+ *
+ * @param ring_name shared memory name starting with a slash
+ * @param frame_size
+ * @param frame_type
+ * @param slot_count
+ * @param fps
+ * @return true on success
+ */
+bool SharedFrameRing::create(const string& ring_name, Size frame_size, int frame_type, int slot_count, double fps) {
+
+    close();
+
+    size_t step = (size_t) frame_size.width * CV_ELEM_SIZE(frame_type);
+    size_t slot_bytes = align_slot(sizeof (SharedFrameSlot)) + align_slot(step * frame_size.height);
+    size_t bytes = align_slot(sizeof (SharedFrameHeader)) + slot_bytes * slot_count;
+
+    shm_unlink(ring_name.c_str());
+
+    int descriptor = shm_open(ring_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (descriptor < 0) {
+        cout << "Cannot create shared memory " << ring_name << endl;
+        return false;
+    }
+
+    if (ftruncate(descriptor, bytes) != 0) {
+        cout << "Cannot allocate shared memory " << ring_name << endl;
+        ::close(descriptor);
+        shm_unlink(ring_name.c_str());
+        return false;
+    }
+
+    mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+
+    if (mapping == MAP_FAILED) {
+        cout << "Cannot map shared memory " << ring_name << endl;
+        shm_unlink(ring_name.c_str());
+        return false;
+    }
+
+    name = ring_name;
+    mapping_bytes = bytes;
+    owner = true;
+
+    // Fresh shared memory is zero filled, so all slots start as empty
+    header = new (mapping) SharedFrameHeader();
+    header->width = frame_size.width;
+    header->height = frame_size.height;
+    header->type = frame_type;
+    header->step = step;
+    header->slot_count = slot_count;
+    header->slot_bytes = slot_bytes;
+    header->fps = fps;
+    header->published.store(0, std::memory_order_relaxed);
+
+    for (int i = 0; i < slot_count; i++) {
+        new (get_slot(i)) SharedFrameSlot();
+    }
+
+    // Consumers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = RING_MAGIC;
+
+    write_frame_number = 0;
+
+    return true;
+}
+
+/**
+ * Attach to a ring created by the frame server.
+ *
+ * @param ring_name
+ * @return true on success
+ */
+bool SharedFrameRing::attach(const string& ring_name) {
+
+    close();
+
+    int descriptor = shm_open(ring_name.c_str(), O_RDONLY, 0);
+    if (descriptor < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || (size_t) status.st_size < sizeof (SharedFrameHeader)) {
+        ::close(descriptor);
+        return false;
+    }
+
+    mapping = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    name = ring_name;
+    mapping_bytes = status.st_size;
+    owner = false;
+    header = (SharedFrameHeader *) mapping;
+
+    if (header->magic != RING_MAGIC) {
+        close();
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // Start with the newest frame
+    read_frame_number = header->published.load(std::memory_order_acquire);
+
+    return true;
+}
+
+/**
+ * Unmap the ring. The server also removes it.
+ */
+void SharedFrameRing::close() {
+
+    if (mapping != MAP_FAILED) {
+        munmap(mapping, mapping_bytes);
+    }
+
+    if (owner) {
+        shm_unlink(name.c_str());
+    }
+
+    mapping = MAP_FAILED;
+    mapping_bytes = 0;
+    owner = false;
+    header = NULL;
+}
+
+/**
+ * Get slot of a frame.
+ *
+ * @param frame_number
+ * @return
+ */
+SharedFrameSlot * SharedFrameRing::get_slot(uint64_t frame_number) const {
+
+    uchar * slots = (uchar *) mapping + align_slot(sizeof (SharedFrameHeader));
+
+    return (SharedFrameSlot *) (slots + (frame_number % header->slot_count) * header->slot_bytes);
+}
+
+/**
+ * Get pixels of a frame.
+ *
+ * @param frame_number
+ * @return
+ */
+uchar * SharedFrameRing::get_slot_data(uint64_t frame_number) const {
+    return (uchar *) get_slot(frame_number) + align_slot(sizeof (SharedFrameSlot));
+}
+
+/**
+ * Mark the next slot as being written and return it for decoding into.
+ *
+ * @return frame header over the slot
+ */
+Mat SharedFrameRing::begin_write() {
+
+    SharedFrameSlot * slot = get_slot(write_frame_number);
+
+    slot->sequence.store(2 * write_frame_number + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return Mat(header->height, header->width, header->type, get_slot_data(write_frame_number), header->step);
+}
+
+/**
+ * Publish the slot returned by begin_write.
+ *
+ * @param frame decoded frame, copied only if the decoder did not write into the slot
+ */
+void SharedFrameRing::end_write(const Mat& frame) {
+
+    uchar * data = get_slot_data(write_frame_number);
+
+    if (frame.data != data) {
+        Mat slot_frame(header->height, header->width, header->type, data, header->step);
+
+        if (frame.size() == slot_frame.size() && frame.type() == slot_frame.type()) {
+            frame.copyTo(slot_frame);
+        } else {
+            resize(frame, slot_frame, slot_frame.size());
+        }
+    }
+
+    SharedFrameSlot * slot = get_slot(write_frame_number);
+
+    slot->timestamp = monotonic_now();
+
+    slot->sequence.store(2 * write_frame_number + 2, std::memory_order_release);
+
+    write_frame_number++;
+    header->published.store(write_frame_number, std::memory_order_release);
+}
+
+/**
+ * Give up the slot returned by begin_write. The slot keeps the odd
+ * sequence of a frame being written, so its previous frame stays invalid
+ * for consumers and the next begin_write reuses it.
+ */
+void SharedFrameRing::cancel_write() {
+
+    SharedFrameSlot * slot = get_slot(write_frame_number);
+
+    slot->sequence.store(2 * write_frame_number + 1, std::memory_order_release);
+}
+
+/**
+ * Publish a frame decoded elsewhere.
+ *
+ * @param frame
+ */
+void SharedFrameRing::publish(const Mat& frame) {
+    begin_write();
+    end_write(frame);
+}
+
+/**
+ * Wait for a frame newer than the last acquired one and return the newest.
+ * Frames published in between are skipped.
+ *
+ * @param frame read-only header over the shared slot
+ * @param sequence pass to is_valid after the frame has been used
+ * @param timeout_ms
+ * @return false if no new frame arrived in time
+ */
+bool SharedFrameRing::acquire(Mat& frame, uint64_t& sequence, int timeout_ms) {
+
+    if (header == NULL) {
+        return false;
+    }
+
+    int64_t deadline = monotonic_now() + (int64_t) timeout_ms * 1000000;
+
+    while (true) {
+
+        uint64_t published = header->published.load(std::memory_order_acquire);
+
+        if (published > read_frame_number) {
+
+            uint64_t frame_number = published - 1;
+            sequence = get_slot(frame_number)->sequence.load(std::memory_order_acquire);
+
+            // Complete and not yet overwritten by a newer frame
+            if (sequence == 2 * frame_number + 2) {
+                read_frame_number = published;
+                frame = Mat(header->height, header->width, header->type, get_slot_data(frame_number), header->step);
+                return true;
+            }
+
+            // The server lapped the reader and is writing the slot again,
+            // the newer frame is published shortly
+            usleep(OVERWRITE_RETRY_US);
+
+        } else {
+
+            usleep(1000);
+
+        }
+
+        if (monotonic_now() >= deadline) {
+            return false;
+        }
+    }
+}
+
+/**
+ * Check that the server did not overwrite a frame while it was used.
+ *
+ * @param sequence
+ * @return
+ */
+bool SharedFrameRing::is_valid(uint64_t sequence) const {
+
+    uint64_t frame_number = sequence / 2 - 1;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return get_slot(frame_number)->sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+/**
+ * Get frame size.
+ *
+ * @return
+ */
+Size SharedFrameRing::get_size() const {
+    return header == NULL ? Size() : Size(header->width, header->height);
+}
+
+/**
+ * Get frame type.
+ *
+ * @return
+ */
+int SharedFrameRing::get_type() const {
+    return header == NULL ? CV_8UC3 : header->type;
+}
+
+/**
+ * Get frame rate of the source.
+ *
+ * @return
+ */
+double SharedFrameRing::get_fps() const {
+    return header == NULL ? 0 : header->fps;
+}
@@ -0,0 +1,96 @@
+/*
+ * File:   SharedFrameRing.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef SHAREDFRAMERING_HPP
+#define SHAREDFRAMERING_HPP
+
+#include <stdint.h>
+#include <string>
+#include "opencv2/opencv.hpp"
+
+using namespace cv;
+using namespace std;
+
+struct SharedFrameHeader;
+struct SharedFrameSlot;
+
+/**
+ * Ring of decoded frames in POSIX shared memory.
+ *
+ * One frame server process creates the ring and decodes straight into its
+ * slots. Any number of consumer processes attach read-only and get frames
+ * as Mat headers over the shared memory, without copying. A consumer that
+ * keeps or modifies a frame has to take it out of shared memory itself,
+ * once, and check is_valid after that copy.
+ *
+ * Every slot carries a sequence counter which is odd while the slot is
+ * being written. A consumer reads the counter before and after using the
+ * frame. If it changed, the server has overwritten the slot meanwhile and
+ * the frame has to be dropped. The server never waits for consumers.
+ */
+class SharedFrameRing {
+public:
+
+    SharedFrameRing();
+    SharedFrameRing(const SharedFrameRing& orig) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing& orig) = delete;
+    virtual ~SharedFrameRing();
+
+    bool create(const string&, Size, int, int, double);
+
+    bool attach(const string&);
+
+    void close();
+
+    // Server side
+
+    Mat begin_write();
+
+    void end_write(const Mat&);
+
+    void cancel_write();
+
+    void publish(const Mat&);
+
+    // Consumer side
+
+    bool acquire(Mat&, uint64_t&, int);
+
+    bool is_valid(uint64_t) const;
+
+    Size get_size() const;
+
+    int get_type() const;
+
+    double get_fps() const;
+
+private:
+
+    // Name of shared memory object
+    string name;
+
+    // Mapping of the whole ring
+    void * mapping;
+    size_t mapping_bytes;
+
+    // Ring created by this process and unlinked on close
+    bool owner;
+
+    SharedFrameHeader * header;
+
+    // Number of the next frame written by the server
+    uint64_t write_frame_number;
+
+    // Number of the last frame returned to the consumer
+    uint64_t read_frame_number;
+
+    SharedFrameSlot * get_slot(uint64_t) const;
+
+    uchar * get_slot_data(uint64_t) const;
+
+};
+
+#endif /* SHAREDFRAMERING_HPP */
+
@@ -0,0 +1,126 @@
+/*
+ * File:   SoakRunner.cpp
+ * Author: Jan Dufek
+ */
+
+#include "SoakRunner.hpp"
+#include "VictimTracker.hpp"
+
+#include <stdio.h>
+#include <unistd.h>
+
+SoakRunner::SoakRunner(Settings& s) {
+
+    settings = &s;
+
+}
+
+SoakRunner::~SoakRunner() {
+}
+
+/**
+ * Get resident set size of this process.
+ *
+ * @return bytes, or 0 if unknown
+ */
+size_t SoakRunner::resident_bytes() {
+
+    FILE * statm = fopen("/proc/self/statm", "r");
+
+    if (statm == NULL) {
+        return 0;
+    }
+
+    long pages = 0;
+    long resident_pages = 0;
+
+    if (fscanf(statm, "%ld %ld", &pages, &resident_pages) != 2) {
+        resident_pages = 0;
+    }
+
+    fclose(statm);
+
+    return (size_t) resident_pages * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Replay the input for the given mission time.
+ *
+ * @param hours simulated mission time
+ * @return 0 if resident memory stayed flat, 1 if it grew, -1 on error
+ */
+int SoakRunner::run(double hours) {
+
+    VideoCapture video_capture(settings->video_capture_source);
+
+    if (!video_capture.isOpened()) {
+        cout << "Cannot open " << settings->video_capture_source << endl;
+        return -1;
+    }
+
+    double fps = video_capture.get(CV_CAP_PROP_FPS);
+    if (fps <= 0) {
+        fps = 30;
+    }
+
+    Size frame_size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+
+    // Mission time is counted in frames of the source
+    int64 leg_frames = max((int64) 1, (int64) (settings->soak_leg_minutes * 60 * fps));
+    int64 legs = max((int64) 1, (int64) (hours * 3600 * fps / leg_frames));
+
+    size_t baseline = 0;
+    size_t peak = 0;
+
+    Mat frame;
+
+    for (int64 leg = 0; leg < legs; leg++) {
+
+        // The tracker of a leg is destroyed at the end of the block
+        {
+            VictimTracker tracker(frame_size, fps, SINK_NONE);
+
+            for (int64 i = 0; i < leg_frames; i++) {
+
+                // Loop the source
+                if (!video_capture.read(frame)) {
+                    video_capture.set(CV_CAP_PROP_POS_FRAMES, 0);
+                    if (!video_capture.read(frame)) {
+                        cout << "No frames in " << settings->video_capture_source << endl;
+                        return -1;
+                    }
+                }
+
+                tracker.push(frame);
+            }
+        }
+
+        size_t resident = resident_bytes();
+
+        // Allocator pools and the thread pool settle during warm-up
+        if (leg + 1 == settings->soak_warmup_legs || (leg == 0 && settings->soak_warmup_legs <= 0)) {
+            baseline = resident;
+        }
+
+        if (leg + 1 > settings->soak_warmup_legs) {
+            peak = max(peak, resident);
+        }
+
+        cout << "Soak leg " << leg + 1 << "/" << legs << " at " << (leg + 1) * leg_frames / fps / 3600 << " h: RSS " << resident / 1024 << " kB" << endl;
+    }
+
+    double growth = peak > baseline ? (double) (peak - baseline) / (1024 * 1024) : 0;
+
+    if (legs <= settings->soak_warmup_legs) {
+        cout << "Soak too short to judge, increase hours or shorten soak_leg_minutes" << endl;
+        return -1;
+    }
+
+    if (growth > settings->soak_rss_tolerance_mb) {
+        cout << "Soak FAILED: RSS grew by " << growth << " MB after warm-up" << endl;
+        return 1;
+    }
+
+    cout << "Soak passed: RSS grew by " << growth << " MB after warm-up" << endl;
+    return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * File:   SoakRunner.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef SOAKRUNNER_HPP
+#define SOAKRUNNER_HPP
+
+#include <stddef.h>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Long-mission memory soak.
+ *
+ * Replays the input video in a loop for hours of simulated mission time.
+ * A new tracker is created for every search leg and destroyed after it,
+ * and resident memory is sampled after every leg. Once the warm-up legs
+ * are over, resident memory has to stay flat within a tolerance.
+ */
+class SoakRunner {
+public:
+
+    SoakRunner(Settings&);
+    SoakRunner(const SoakRunner& orig) = delete;
+    SoakRunner& operator=(const SoakRunner& orig) = delete;
+    virtual ~SoakRunner();
+
+    int run(double);
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    static size_t resident_bytes();
+
+};
+
+#endif /* SOAKRUNNER_HPP */
+
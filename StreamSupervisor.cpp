@@ -0,0 +1,303 @@
+/*
+ * File:   StreamSupervisor.cpp
+ * Author: Jan Dufek
+ */
+
+#include "StreamSupervisor.hpp"
+
+#include <unistd.h>
+
+// Longest sleep of a single read in milliseconds
+static const int WAIT_SLICE_MS = 100;
+
+StreamSupervisor::StreamSupervisor(Settings& s) {
+
+    settings = &s;
+
+    source_index = -1;
+    is_file = false;
+    ended = false;
+
+    last_frame_ticks = getTickCount();
+    next_attempt_ticks = 0;
+    outage_start_ticks = 0;
+    backoff_ms = 0;
+
+}
+
+StreamSupervisor::~StreamSupervisor() {
+}
+
+/**
+ * Check whether a source name is a live source rather than a file. Network
+ * streams have a protocol, cameras are device nodes and GStreamer
+ * pipelines link their elements with "!".
+ *
+ * @param name
+ * @return
+ */
+bool StreamSupervisor::is_live(const string& name) {
+    return name.find("://") != string::npos || name.compare(0, 5, "/dev/") == 0 || name.find('!') != string::npos;
+}
+
+/**
+ * Open a file or a live source.
+ *
+ * @param name
+ * @return whether the source opened
+ */
+bool StreamSupervisor::open(const string& name) {
+
+    source_name = name;
+    source_index = -1;
+    is_file = !is_live(name);
+
+    return connect();
+}
+
+/**
+ * Open a camera.
+ *
+ * @param index
+ * @return whether the camera opened
+ */
+bool StreamSupervisor::open(int index) {
+
+    source_name = "";
+    source_index = index;
+    is_file = false;
+
+    return connect();
+}
+
+/**
+ * First open of the source. A file which does not open has ended, a stream
+ * which is not up yet is reconnected like a stalled one.
+ *
+ * @return whether the source opened
+ */
+bool StreamSupervisor::connect() {
+
+    statistics.connected = (source_index >= 0) ? video_capture.open(source_index) : video_capture.open(source_name);
+    last_frame_ticks = getTickCount();
+
+    if (!statistics.connected) {
+        if (is_file) {
+            ended = true;
+        } else {
+            begin_outage();
+        }
+    }
+
+    return statistics.connected;
+}
+
+/**
+ * Read the next frame. Returns without a frame while the source is down,
+ * after sleeping for the empty read or a slice of the backoff.
+ *
+ * @param frame
+ * @return whether a frame was read
+ */
+bool StreamSupervisor::read(Mat& frame) {
+
+    if (!pending_frame.empty()) {
+        frame = pending_frame;
+        pending_frame.release();
+        return true;
+    }
+
+    if (ended) {
+        frame.release();
+        return false;
+    }
+
+    if (!statistics.connected) {
+
+        double wait_ms = (next_attempt_ticks - getTickCount()) * 1000. / getTickFrequency();
+
+        // Not yet time to try again
+        if (wait_ms > 0) {
+            sleep_ms(min(wait_ms, (double) WAIT_SLICE_MS));
+            frame.release();
+            return false;
+        }
+
+        if (!reopen()) {
+            frame.release();
+            return false;
+        }
+    }
+
+    if (video_capture.read(frame) && !frame.empty()) {
+        last_frame_ticks = getTickCount();
+        frame_size = frame.size();
+        return true;
+    }
+
+    statistics.empty_reads++;
+
+    if (seconds_since(last_frame_ticks) >= settings->stream_stall_seconds) {
+
+        if (is_file) {
+            ended = true;
+            statistics.connected = false;
+        } else {
+            begin_outage();
+        }
+
+    } else {
+
+        // A stream between frames or a dropped packet, do not poll again right away
+        sleep_ms(settings->stream_empty_read_sleep_ms);
+
+    }
+
+    frame.release();
+    return false;
+}
+
+/**
+ * Block until the source delivers a frame, reconnecting with backoff while
+ * it is down. The frame is kept for the next read.
+ *
+ * @return false if the source ended without a frame
+ */
+bool StreamSupervisor::wait_for_frame() {
+
+    if (!pending_frame.empty()) {
+        return true;
+    }
+
+    Mat frame;
+
+    while (!read(frame)) {
+        if (ended) {
+            return false;
+        }
+    }
+
+    pending_frame = frame;
+
+    return true;
+}
+
+/**
+ * Get the size of the last frame read.
+ *
+ * @return size, empty before the first frame
+ */
+Size StreamSupervisor::get_frame_size() {
+    return frame_size;
+}
+
+/**
+ * Release the stalled source and schedule the first reopen.
+ */
+void StreamSupervisor::begin_outage() {
+
+    video_capture.release();
+
+    statistics.connected = false;
+    statistics.outages++;
+
+    // The outage started with the last frame
+    outage_start_ticks = last_frame_ticks;
+
+    backoff_ms = settings->stream_reconnect_initial_ms;
+    next_attempt_ticks = getTickCount() + (int64) (backoff_ms * getTickFrequency() / 1000);
+
+    cout << "Stream " << (source_index >= 0 ? to_string(source_index) : source_name) << " is down, reconnecting" << endl;
+}
+
+/**
+ * Try to reopen the source. A failed attempt doubles the delay to the next
+ * one up to the maximum.
+ *
+ * @return whether the source opened
+ */
+bool StreamSupervisor::reopen() {
+
+    statistics.reconnect_attempts++;
+
+    bool opened = (source_index >= 0) ? video_capture.open(source_index) : video_capture.open(source_name);
+
+    double outage = seconds_since(outage_start_ticks);
+
+    if (opened) {
+
+        statistics.connected = true;
+        statistics.reconnects++;
+        statistics.outage_seconds += outage;
+        statistics.longest_outage_seconds = max(statistics.longest_outage_seconds, outage);
+
+        // Give the stream the whole stall time to deliver the first frame
+        last_frame_ticks = getTickCount();
+
+        cout << "Stream reconnected after " << outage << " s" << endl;
+
+        return true;
+    }
+
+    if (settings->stream_max_outage_seconds > 0 && outage >= settings->stream_max_outage_seconds) {
+
+        ended = true;
+        statistics.outage_seconds += outage;
+        statistics.longest_outage_seconds = max(statistics.longest_outage_seconds, outage);
+
+        cout << "Stream lost for " << outage << " s, giving up" << endl;
+
+        return false;
+    }
+
+    backoff_ms = min(max(backoff_ms * 2, (double) settings->stream_reconnect_initial_ms), (double) settings->stream_reconnect_max_ms);
+    next_attempt_ticks = getTickCount() + (int64) (backoff_ms * getTickFrequency() / 1000);
+
+    return false;
+}
+
+/**
+ * Check whether the source ended and no more frames will come.
+ *
+ * @return
+ */
+bool StreamSupervisor::has_ended() {
+    return ended && pending_frame.empty();
+}
+
+/**
+ * Get a property of the open source.
+ *
+ * @param property_id
+ * @return
+ */
+double StreamSupervisor::get(int property_id) {
+    return video_capture.get(property_id);
+}
+
+StreamStatistics StreamSupervisor::get_statistics() {
+    return statistics;
+}
+
+/**
+ * Print outage counters if there were any outages.
+ */
+void StreamSupervisor::print_statistics() {
+
+    if (statistics.outages == 0) {
+        return;
+    }
+
+    cout << "Stream outages: " << statistics.outages << ", reconnects: " << statistics.reconnects << "/" << statistics.reconnect_attempts << ", time without stream: " << statistics.outage_seconds << " s, longest: " << statistics.longest_outage_seconds << " s" << endl;
+}
+
+double StreamSupervisor::seconds_since(int64 ticks) {
+    return (getTickCount() - ticks) / getTickFrequency();
+}
+
+void StreamSupervisor::sleep_ms(double milliseconds) {
+
+    if (milliseconds > 0) {
+        usleep((useconds_t) (milliseconds * 1000));
+    }
+}
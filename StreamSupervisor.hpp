@@ -0,0 +1,128 @@
+/*
+ * File:   StreamSupervisor.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef STREAMSUPERVISOR_HPP
+#define STREAMSUPERVISOR_HPP
+
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Outage counters of a supervised stream.
+ */
+struct StreamStatistics {
+
+    // Source is open and delivering frames
+    bool connected = false;
+
+    // Number of times the source stalled or ended
+    long outages = 0;
+
+    // Attempts to reopen the source and how many of them succeeded
+    long reconnect_attempts = 0;
+    long reconnects = 0;
+
+    // Reads which returned no frame
+    long empty_reads = 0;
+
+    // Time without frames, in total and the longest single outage
+    double outage_seconds = 0;
+    double longest_outage_seconds = 0;
+
+};
+
+/**
+ * Reads a video source and reopens it when it drops.
+ *
+ * A source which gives no frame for stream_stall_seconds is stalled.
+ * Files end there. Streams and cameras are released and reopened with
+ * exponential backoff until they deliver again or stream_max_outage_seconds
+ * passes. Empty reads and waits for the next attempt sleep, and a single
+ * read never sleeps longer than a short slice, so the caller keeps serving
+ * its window meanwhile.
+ *
+ * Frame size and rate are only known once a frame arrived, so a tracker
+ * waits for the first frame with wait_for_frame before it sets up.
+ */
+class StreamSupervisor {
+public:
+
+    StreamSupervisor(Settings&);
+    StreamSupervisor(const StreamSupervisor& orig) = delete;
+    StreamSupervisor& operator=(const StreamSupervisor& orig) = delete;
+    virtual ~StreamSupervisor();
+
+    bool open(const string&);
+
+    bool open(int);
+
+    bool read(Mat&);
+
+    bool wait_for_frame();
+
+    Size get_frame_size();
+
+    bool has_ended();
+
+    static bool is_live(const string&);
+
+    double get(int);
+
+    StreamStatistics get_statistics();
+
+    void print_statistics();
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    VideoCapture video_capture;
+
+    // Source as given to open, by name or camera index
+    string source_name;
+    int source_index;
+
+    // Files end instead of being reopened
+    bool is_file;
+
+    // Frame read by wait_for_frame, returned by the next read
+    Mat pending_frame;
+
+    // Size of the last frame
+    Size frame_size;
+
+    // Source stalled for good
+    bool ended;
+
+    // Time of the last frame and of the next reopen attempt in ticks
+    int64 last_frame_ticks;
+    int64 next_attempt_ticks;
+
+    // Start of the current outage in ticks
+    int64 outage_start_ticks;
+
+    // Current reopen delay in milliseconds
+    double backoff_ms;
+
+    StreamStatistics statistics;
+
+    bool connect();
+
+    bool reopen();
+
+    void begin_outage();
+
+    double seconds_since(int64);
+
+    static void sleep_ms(double);
+
+};
+
+#endif /* STREAMSUPERVISOR_HPP */
+
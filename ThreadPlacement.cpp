@@ -0,0 +1,286 @@
+/*
+ * File:   ThreadPlacement.cpp
+ * Author: Jan Dufek
+ */
+
+#include "ThreadPlacement.hpp"
+
+#include <sstream>
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+int ThreadPlacement::placed_roles = 0;
+
+ThreadPlacement::ThreadPlacement(Settings& s) {
+    settings = &s;
+}
+
+ThreadPlacement::~ThreadPlacement() {
+}
+
+/**
+ * Parse a core list like "0", "2-3" or "0,2-3".
+ *
+ * @param text
+ * @param cores output, empty for an empty list
+ * @return false if the list cannot be parsed or names a core past CPU_SETSIZE
+ */
+bool ThreadPlacement::parse_cores(const string& text, vector<int>& cores) {
+
+    cores.clear();
+
+    stringstream stream(text);
+    string item;
+
+    while (getline(stream, item, ',')) {
+
+        if (item.empty()) {
+            continue;
+        }
+
+        int first;
+        int last;
+        char separator;
+        stringstream range(item);
+
+        if (!(range >> first)) {
+            return false;
+        }
+
+        if (range >> separator) {
+            if (separator != '-' || !(range >> last) || last < first) {
+                return false;
+            }
+        } else {
+            last = first;
+        }
+
+        // Nothing may follow the range
+        if (range >> separator) {
+            return false;
+        }
+
+        if (first < 0 || last >= CPU_SETSIZE) {
+            return false;
+        }
+
+        for (int core = first; core <= last; core++) {
+            cores.push_back(core);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Format cores as ranges.
+ *
+ * @param cores sorted core list
+ * @return
+ */
+string ThreadPlacement::format_cores(const vector<int>& cores) {
+
+    stringstream text;
+
+    for (size_t i = 0; i < cores.size(); i++) {
+
+        size_t last = i;
+        while (last + 1 < cores.size() && cores[last + 1] == cores[last] + 1) {
+            last++;
+        }
+
+        text << (i > 0 ? "," : "") << cores[i];
+        if (last > i) {
+            text << "-" << cores[last];
+        }
+
+        i = last;
+    }
+
+    return text.str();
+}
+
+/**
+ * Name of a role in the report.
+ *
+ * @param role
+ * @return
+ */
+string ThreadPlacement::role_name(ThreadRole role) {
+
+    switch (role) {
+        case THREAD_CAPTURE:
+            return "capture";
+        case THREAD_PROCESSING:
+            return "processing";
+        case THREAD_IO:
+            return "io";
+    }
+
+    return "";
+}
+
+/**
+ * Place a thread as configured for its role and print what was applied.
+ * Roles without configuration are left alone and not reported. The
+ * calling thread is placed only on the first call for a role.
+ *
+ * @param role
+ * @param thread thread or process id, 0 for the calling thread
+ * @return false if any part of the configuration could not be applied
+ */
+bool ThreadPlacement::apply(ThreadRole role, pid_t thread) {
+
+    if (thread == 0) {
+
+        if (placed_roles & (1 << role)) {
+            return true;
+        }
+
+        placed_roles |= 1 << role;
+    }
+
+    string cores_text;
+    int realtime_priority;
+    int nice_value;
+
+    switch (role) {
+        case THREAD_CAPTURE:
+            cores_text = settings->capture_cores;
+            realtime_priority = settings->capture_realtime_priority;
+            nice_value = settings->capture_nice;
+            break;
+        case THREAD_PROCESSING:
+            cores_text = settings->processing_cores;
+            realtime_priority = settings->processing_realtime_priority;
+            nice_value = settings->processing_nice;
+            break;
+        default:
+            cores_text = settings->io_cores;
+            realtime_priority = settings->io_realtime_priority;
+            nice_value = settings->io_nice;
+            break;
+    }
+
+    bool pool_capped = role == THREAD_PROCESSING && settings->opencv_threads > 0;
+
+    if (cores_text.empty() && realtime_priority <= 0 && nice_value == 0 && !pool_capped) {
+        return true;
+    }
+
+    string name = role_name(role);
+    bool applied = true;
+
+    if (thread == 0) {
+        thread = syscall(SYS_gettid);
+    }
+
+    // Cores
+    vector<int> cores;
+
+    if (!parse_cores(cores_text, cores)) {
+
+        cout << "Invalid core list \"" << cores_text << "\" of the " << name << " thread" << endl;
+        applied = false;
+
+    } else if (!cores.empty()) {
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < cores.size(); i++) {
+            CPU_SET(cores[i], &set);
+        }
+
+        if (sched_setaffinity(thread, sizeof (set), &set) != 0) {
+            cout << "Cannot pin the " << name << " thread to cores " << cores_text << ": " << strerror(errno) << endl;
+            applied = false;
+        }
+    }
+
+    // Scheduling
+    if (realtime_priority > 0) {
+
+        sched_param parameters;
+        parameters.sched_priority = min(max(realtime_priority, sched_get_priority_min(SCHED_FIFO)), sched_get_priority_max(SCHED_FIFO));
+
+        if (sched_setscheduler(thread, SCHED_FIFO, &parameters) != 0) {
+            cout << "Cannot set SCHED_FIFO priority " << parameters.sched_priority << " of the " << name << " thread: " << strerror(errno) << endl;
+            applied = false;
+        }
+
+    } else if (nice_value != 0) {
+
+        if (setpriority(PRIO_PROCESS, thread, nice_value) != 0) {
+            cout << "Cannot set nice " << nice_value << " of the " << name << " thread: " << strerror(errno) << endl;
+            applied = false;
+        }
+
+    }
+
+    // OpenCV pool, only ever made smaller. Chunk workers run on one thread.
+    if (pool_capped && getNumThreads() > settings->opencv_threads) {
+        setNumThreads(settings->opencv_threads);
+    }
+
+    report(role, thread);
+
+    return applied;
+}
+
+/**
+ * Print affinity and scheduling of a thread as the kernel reports them.
+ *
+ * @param role
+ * @param thread
+ */
+void ThreadPlacement::report(ThreadRole role, pid_t thread) {
+
+    cout << "Thread " << role_name(role) << " (" << thread << "):";
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (sched_getaffinity(thread, sizeof (set), &set) == 0) {
+
+        vector<int> cores;
+        for (int core = 0; core < CPU_SETSIZE; core++) {
+            if (CPU_ISSET(core, &set)) {
+                cores.push_back(core);
+            }
+        }
+
+        cout << " cores " << format_cores(cores);
+    }
+
+    int policy = sched_getscheduler(thread);
+
+    if (policy == SCHED_FIFO || policy == SCHED_RR) {
+
+        sched_param parameters;
+        sched_getparam(thread, &parameters);
+
+        cout << (policy == SCHED_FIFO ? " SCHED_FIFO " : " SCHED_RR ") << parameters.sched_priority;
+
+    } else {
+
+        errno = 0;
+        int nice_value = getpriority(PRIO_PROCESS, thread);
+
+        cout << " SCHED_OTHER";
+        if (errno == 0) {
+            cout << " nice " << nice_value;
+        }
+
+    }
+
+    if (role == THREAD_PROCESSING) {
+        cout << " OpenCV threads " << getNumThreads();
+    }
+
+    cout << endl;
+
+}
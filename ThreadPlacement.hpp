@@ -0,0 +1,72 @@
+/*
+ * File:   ThreadPlacement.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef THREADPLACEMENT_HPP
+#define THREADPLACEMENT_HPP
+
+#include <sys/types.h>
+#include "opencv2/opencv.hpp"
+#include "Settings.hpp"
+
+using namespace cv;
+using namespace std;
+
+// What a thread does, each role is placed separately
+enum ThreadRole {
+    THREAD_CAPTURE, // Frame server decoding the source
+    THREAD_PROCESSING, // Tracker and the OpenCV pool it starts
+    THREAD_IO // Stream copy of the recording
+};
+
+/**
+ * Core affinity and scheduling of the tracker threads on a shared board.
+ *
+ * Every role can be pinned to a list of cores and run either with a
+ * SCHED_FIFO priority or with a nice value. The OpenCV pool is started
+ * by the processing thread on its first parallel loop and its workers
+ * inherit the affinity and the scheduling of that thread, so placing the
+ * processing thread before the video source is opened places the pool and
+ * the decoder threads of VideoCapture too. The pool size can be capped
+ * separately, a smaller pool set by the caller is kept.
+ *
+ * The calling thread is placed once per role and process. Trackers
+ * created again in the same process, for every chunk or soak leg, neither
+ * place nor report it again.
+ *
+ * What the kernel actually applied is read back and printed, because
+ * real-time priorities fail without CAP_SYS_NICE or an rtprio limit and
+ * cores may be missing from the cpuset of the process.
+ */
+class ThreadPlacement {
+public:
+
+    ThreadPlacement(Settings&);
+    ThreadPlacement(const ThreadPlacement& orig) = delete;
+    ThreadPlacement& operator=(const ThreadPlacement& orig) = delete;
+    virtual ~ThreadPlacement();
+
+    bool apply(ThreadRole, pid_t = 0);
+
+    static bool parse_cores(const string&, vector<int>&);
+
+private:
+
+    // Program settings
+    Settings * settings;
+
+    // Roles the calling threads of this process were placed for, one bit
+    // per role
+    static int placed_roles;
+
+    static string role_name(ThreadRole);
+
+    static string format_cores(const vector<int>&);
+
+    void report(ThreadRole, pid_t);
+
+};
+
+#endif /* THREADPLACEMENT_HPP */
+
@@ -0,0 +1,255 @@
+/*
+ * File:   Tracer.cpp
+ * Author: Jan Dufek
+ */
+
+#include "Tracer.hpp"
+
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <time.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * One recorded event.
+ */
+struct TraceEvent {
+    const char * name;
+    int64_t begin;
+    int64_t end;
+    int64_t frame;
+};
+
+/**
+ * Events of one thread. Only the owning thread writes, so the count is
+ * published with release and the dump reads events below it.
+ */
+struct TraceBuffer {
+    vector<TraceEvent> events;
+    std::atomic<int> count;
+    std::atomic<int64_t> dropped;
+    long thread_id;
+    string thread_name;
+};
+
+std::atomic<bool> Tracer::enabled(false);
+std::atomic<int64_t> Tracer::frame(0);
+int Tracer::capacity = 0;
+volatile std::sig_atomic_t Tracer::dump_requested = 0;
+
+// Buffers of all threads, registered once per thread
+static std::mutex buffers_mutex;
+static vector<TraceBuffer *> buffers;
+
+// Buffer of the calling thread
+static thread_local TraceBuffer * thread_buffer = NULL;
+
+/**
+ * Start recording.
+ *
+ * @param events_per_thread capacity of every thread buffer, later events are dropped
+ */
+void Tracer::enable(int events_per_thread) {
+
+    capacity = events_per_thread;
+
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * Check whether events are recorded.
+ *
+ * @return
+ */
+bool Tracer::is_enabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Tag following events of all threads with the frame number.
+ *
+ * @param frame_number
+ */
+void Tracer::set_frame(int64_t frame_number) {
+    frame.store(frame_number, std::memory_order_relaxed);
+}
+
+/**
+ * Monotonic time in nanoseconds.
+ *
+ * @return
+ */
+int64_t Tracer::now() {
+
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (int64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**
+ * Get buffer of the calling thread, creating it on the first event.
+ *
+ * @return
+ */
+TraceBuffer * Tracer::get_buffer() {
+
+    if (thread_buffer == NULL) {
+
+        TraceBuffer * buffer = new TraceBuffer();
+        buffer->events.resize(capacity);
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        buffer->thread_id = syscall(SYS_gettid);
+
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffers.push_back(buffer);
+
+        // Buffers live until the process ends, the dump may run after the thread exited
+        thread_buffer = buffer;
+    }
+
+    return thread_buffer;
+}
+
+/**
+ * Name the calling thread in the timeline.
+ *
+ * @param thread_name
+ */
+void Tracer::name_thread(const char * thread_name) {
+
+    if (!is_enabled()) {
+        return;
+    }
+
+    TraceBuffer * buffer = get_buffer();
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffer->thread_name = thread_name;
+}
+
+/**
+ * Record one complete event of the calling thread.
+ *
+ * @param name string literal
+ * @param begin
+ * @param end
+ */
+void Tracer::record(const char * name, int64_t begin, int64_t end) {
+
+    TraceBuffer * buffer = get_buffer();
+
+    int index = buffer->count.load(std::memory_order_relaxed);
+
+    if (index >= (int) buffer->events.size()) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent& event = buffer->events[index];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.frame = frame.load(std::memory_order_relaxed);
+
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * Signal handler, only sets a flag.
+ *
+ * @param signal_number
+ */
+void Tracer::on_signal(int signal_number) {
+    dump_requested = 1;
+}
+
+/**
+ * Dump the timeline when the signal arrives, for example SIGUSR1.
+ *
+ * @param signal_number
+ */
+void Tracer::dump_on_signal(int signal_number) {
+    signal(signal_number, on_signal);
+}
+
+/**
+ * Write the timeline if a signal requested it. Called from the main loop,
+ * because writing files is not allowed in a signal handler.
+ *
+ * @param file_name
+ */
+void Tracer::poll(const string& file_name) {
+
+    if (dump_requested) {
+        dump_requested = 0;
+        dump(file_name);
+    }
+}
+
+/**
+ * Write all events recorded so far as Chrome trace JSON.
+ *
+ * @param file_name
+ * @return false if the file cannot be written
+ */
+bool Tracer::dump(const string& file_name) {
+
+    ofstream trace_file(file_name.c_str());
+
+    if (!trace_file.is_open()) {
+        cout << "Cannot open the trace file " << file_name << " for write." << endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+
+    trace_file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    int64_t events = 0;
+    int64_t dropped = 0;
+    pid_t process_id = getpid();
+
+    for (size_t b = 0; b < buffers.size(); b++) {
+
+        TraceBuffer * buffer = buffers[b];
+
+        if (!buffer->thread_name.empty()) {
+            trace_file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << process_id << ",\"tid\":" << buffer->thread_id << ",\"args\":{\"name\":\"" << buffer->thread_name << "\"}}";
+            first = false;
+        }
+
+        int count = buffer->count.load(std::memory_order_acquire);
+
+        for (int i = 0; i < count; i++) {
+
+            const TraceEvent& event = buffer->events[i];
+
+            // Microseconds with nanosecond fraction
+            trace_file << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << process_id << ",\"tid\":" << buffer->thread_id
+                    << ",\"ts\":" << event.begin / 1000 << "." << (event.begin % 1000) / 100
+                    << ",\"dur\":" << (event.end - event.begin) / 1000 << "." << ((event.end - event.begin) % 1000) / 100
+                    << ",\"args\":{\"frame\":" << event.frame << "}}";
+            first = false;
+        }
+
+        events += count;
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+
+    trace_file << "\n]}\n";
+
+    cout << "Trace of " << events << " events written to " << file_name;
+    if (dropped > 0) {
+        cout << ", " << dropped << " events dropped because buffers were full";
+    }
+    cout << endl;
+
+    return true;
+}
@@ -0,0 +1,105 @@
+/*
+ * File:   Tracer.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <csignal>
+#include <string>
+
+using namespace std;
+
+struct TraceBuffer;
+
+/**
+ * Per-frame timeline of pipeline stages in Chrome trace event format.
+ *
+ * Every thread records into its own buffer, preallocated on the first event
+ * of the thread, so recording takes no lock and no allocation. Events carry
+ * the number of the frame being processed. The timeline is written as JSON
+ * which loads into chrome://tracing or Perfetto.
+ *
+ * When tracing is disabled a scope costs one relaxed load.
+ */
+class Tracer {
+public:
+
+    static void enable(int);
+
+    static bool is_enabled();
+
+    static void set_frame(int64_t);
+
+    static void record(const char*, int64_t, int64_t);
+
+    static int64_t now();
+
+    static void name_thread(const char*);
+
+    static void dump_on_signal(int);
+
+    static void poll(const string&);
+
+    static bool dump(const string&);
+
+private:
+
+    static std::atomic<bool> enabled;
+
+    // Frame being processed by the vision thread
+    static std::atomic<int64_t> frame;
+
+    // Events per thread buffer
+    static int capacity;
+
+    // Dump was requested by a signal
+    static volatile std::sig_atomic_t dump_requested;
+
+    static void on_signal(int);
+
+    static TraceBuffer * get_buffer();
+
+};
+
+/**
+ * Records the lifetime of the scope as one event.
+ */
+class TraceScope {
+public:
+
+    /**
+     * Begin event.
+     *
+     * @param event_name string literal, kept by pointer
+     */
+    TraceScope(const char * event_name) {
+        name = event_name;
+        begin = Tracer::is_enabled() ? Tracer::now() : -1;
+    }
+
+    TraceScope(const TraceScope& orig) = delete;
+    TraceScope& operator=(const TraceScope& orig) = delete;
+
+    /**
+     * End event.
+     */
+    ~TraceScope() {
+        if (begin >= 0) {
+            Tracer::record(name, begin, Tracer::now());
+        }
+    }
+
+private:
+
+    const char * name;
+
+    int64_t begin;
+
+};
+
+#endif /* TRACER_HPP */
+
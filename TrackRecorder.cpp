@@ -0,0 +1,198 @@
+/*
+ * File:   TrackRecorder.cpp
+ * Author: Jan Dufek
+ */
+
+#include "TrackRecorder.hpp"
+#include "StreamSupervisor.hpp"
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/**
+ * Create sidecar for a recording.
+ *
+ * @param recording_name file name without extension
+ * @param size source frame size
+ * @param frame_rate source frame rate
+ */
+TrackRecorder::TrackRecorder(const string& recording_name, Size size, double frame_rate) {
+
+    name = recording_name;
+    frame_size = size;
+    fps = frame_rate;
+
+    source = "none";
+    alignment = "frame";
+    header_written = false;
+    copy_process = 0;
+
+    track_file.open(name + ".track");
+
+    if (!track_file.is_open()) {
+        cout << "Cannot open the track file " << name + ".track" << " for write." << endl;
+    }
+
+    start_ticks = getTickCount();
+}
+
+TrackRecorder::~TrackRecorder() {
+
+    // Let ffmpeg finish the container
+    if (copy_process > 0) {
+        kill(copy_process, SIGINT);
+        waitpid(copy_process, NULL, 0);
+    }
+
+    track_file.close();
+}
+
+/**
+ * Keep the clean source next to the track. Files are referenced in place.
+ * Network streams are copied without re-encoding by an ffmpeg process.
+ * Cameras and GStreamer pipelines cannot be copied, only the track is
+ * recorded for them.
+ *
+ * @param video_source
+ */
+void TrackRecorder::copy_source(const string& video_source) {
+
+    // Files are already on disk
+    if (!StreamSupervisor::is_live(video_source)) {
+        source = video_source;
+        alignment = "frame";
+        return;
+    }
+
+    if (video_source.find("://") == string::npos) {
+        source = "none";
+        return;
+    }
+
+    string copy_name = name + ".mkv";
+
+    copy_process = fork();
+
+    if (copy_process == 0) {
+        execlp("ffmpeg", "ffmpeg", "-loglevel", "error", "-i", video_source.c_str(), "-c", "copy", "-y", copy_name.c_str(), (char *) NULL);
+        _exit(127);
+    }
+
+    if (copy_process < 0) {
+        cout << "Cannot start stream copy of " << video_source << endl;
+        copy_process = 0;
+        return;
+    }
+
+    // The copy starts at another frame than the track, so frames are
+    // matched by time from the anchor frame
+    source = copy_name;
+    alignment = "time";
+}
+
+/**
+ * Keep a thumbnail of the first recorded frame and count time from it.
+ * Later calls do nothing. Without time alignment no anchor is needed.
+ *
+ * @param frame source frame about to be recorded
+ */
+void TrackRecorder::set_anchor(const Mat& frame) {
+
+    if (alignment != "time" || !anchor.empty() || frame.empty()) {
+        return;
+    }
+
+    anchor = thumbnail(frame);
+    start_ticks = getTickCount();
+}
+
+/**
+ * Grayscale thumbnail compared between the track anchor and the copy.
+ *
+ * @param frame
+ * @return
+ */
+Mat TrackRecorder::thumbnail(const Mat& frame) {
+
+    Mat small, gray;
+
+    resize(frame, small, Size(ANCHOR_WIDTH, max(ANCHOR_WIDTH * frame.rows / max(frame.cols, 1), 1)), 0, 0, INTER_AREA);
+    cvtColor(small, gray, COLOR_BGR2GRAY);
+
+    return gray;
+}
+
+/**
+ * Get the stream copy process.
+ *
+ * @return process id, or 0 if no stream is copied
+ */
+pid_t TrackRecorder::get_copy_process() {
+    return copy_process;
+}
+
+/**
+ * Write the header once the source is known.
+ */
+void TrackRecorder::write_header() {
+
+    track_file << "# EMILY track" << endl;
+    track_file << "source " << source << endl;
+    track_file << "alignment " << alignment << endl;
+    track_file << "size " << frame_size.width << " " << frame_size.height << endl;
+    track_file << "fps " << fps << endl;
+
+    if (!anchor.empty()) {
+
+        track_file << "anchor " << anchor.cols << " " << anchor.rows;
+
+        for (int y = 0; y < anchor.rows; y++) {
+            for (int x = 0; x < anchor.cols; x++) {
+                track_file << " " << (int) anchor.at<uchar>(y, x);
+            }
+        }
+
+        track_file << endl;
+    }
+
+    track_file << "# frame time valid x y width height angle confidence status" << endl;
+
+    header_written = true;
+}
+
+/**
+ * Record result of one frame.
+ *
+ * @param result
+ * @param status
+ */
+void TrackRecorder::write(const TrackingResult& result, int status) {
+
+    write(result, status, (getTickCount() - start_ticks) * 1000. / getTickFrequency());
+}
+
+/**
+ * Record result of one frame at a given time, for tracks written after the
+ * fact.
+ *
+ * @param result
+ * @param status
+ * @param time milliseconds since the start of the source
+ */
+void TrackRecorder::write(const TrackingResult& result, int status, double time) {
+
+    if (!header_written) {
+        write_header();
+    }
+
+    track_file << result.frame_number << " " << (int64) time << " " << result.valid;
+
+    if (result.valid) {
+        track_file << " " << result.center.x << " " << result.center.y << " " << result.size.width << " " << result.size.height << " " << result.angle << " " << result.confidence;
+    } else {
+        track_file << " 0 0 0 0 0 0";
+    }
+
+    track_file << " " << status << "\n";
+}
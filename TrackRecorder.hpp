@@ -0,0 +1,93 @@
+/*
+ * File:   TrackRecorder.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef TRACKRECORDER_HPP
+#define TRACKRECORDER_HPP
+
+#include <fstream>
+#include <sys/types.h>
+#include "opencv2/opencv.hpp"
+#include "TrackingResult.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Writes the tracking result of every frame into a small text sidecar, so
+ * overlays can be rendered offline by OverlayRenderer instead of encoding
+ * annotated video on the boat.
+ *
+ * The sidecar starts with a header of "key value" lines followed by one
+ * line per frame:
+ *
+ *     frame time valid x y width height angle confidence status
+ *
+ * Coordinates are in pixels of the source frames and time is milliseconds
+ * since the recording started. Frames are matched to the source video by
+ * frame number if the source is a file and by time if it is a copied
+ * network stream.
+ *
+ * The copy and the tracker open the stream separately, so they do not start
+ * at the same frame. For time alignment the header carries a grayscale
+ * thumbnail of the first recorded frame, the anchor. The renderer finds the
+ * anchor in the copy and counts time from there.
+ */
+class TrackRecorder {
+public:
+
+    TrackRecorder(const string&, Size, double);
+    TrackRecorder(const TrackRecorder& orig) = delete;
+    TrackRecorder& operator=(const TrackRecorder& orig) = delete;
+    virtual ~TrackRecorder();
+
+    void copy_source(const string&);
+
+    void set_anchor(const Mat&);
+
+    pid_t get_copy_process();
+
+    void write(const TrackingResult&, int);
+
+    void write(const TrackingResult&, int, double);
+
+    static Mat thumbnail(const Mat&);
+
+    // Width of the anchor thumbnail in pixels
+    static const int ANCHOR_WIDTH = 32;
+
+private:
+
+    // Sidecar file
+    ofstream track_file;
+
+    // Name of recording without extension
+    string name;
+
+    // Header is written before the first frame
+    bool header_written;
+
+    // Source frame size and frame rate
+    Size frame_size;
+    double fps;
+
+    // Source video and how frames align with it
+    string source;
+    string alignment;
+
+    // Stream copy process or 0 if none
+    pid_t copy_process;
+
+    // Start of the recording, or when the anchor frame was recorded
+    int64 start_ticks;
+
+    // Thumbnail of the first recorded frame, for time alignment only
+    Mat anchor;
+
+    void write_header();
+
+};
+
+#endif /* TRACKRECORDER_HPP */
+
@@ -0,0 +1,61 @@
+/*
+ * File:   TrackingResult.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef TRACKINGRESULT_HPP
+#define TRACKINGRESULT_HPP
+
+#include <stdint.h>
+#include "opencv2/opencv.hpp"
+#include "CameraModel.hpp"
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Result of tracking in one frame, returned to the host.
+ */
+struct TrackingResult {
+
+    // Number of the frame since the tracker was created
+    int64_t frame_number = 0;
+
+    // Monotonic time the frame was pushed in nanoseconds
+    int64_t timestamp = 0;
+
+    // Victim is tracked and the box below is valid
+    bool valid = false;
+
+    // Center of the victim in pixels of the pushed frame
+    Point2f center;
+
+    // Size of the victim in pixels of the pushed frame
+    Size2f size;
+
+    // Orientation of the box in degrees
+    float angle = 0;
+
+    // Tracking confidence in range 0-1
+    double confidence = 0;
+
+    // Global image shift since the previous processed frame in pixels of
+    // the pushed frame, only with ego-motion compensation
+    Point2f camera_motion;
+
+    // Number of competing hypotheses, only above 1 with particle tracking
+    int modes = 0;
+
+    // Bearing and angular size of the victim, if calibration is available
+    TargetBearing bearing;
+
+    // The frame did not change and the previous result was reused
+    bool reused = false;
+
+    // Time spent processing the frame in milliseconds
+    double processing_time = 0;
+
+};
+
+#endif /* TRACKINGRESULT_HPP */
+
@@ -32,10 +32,11 @@ UserInterface::UserInterface(Settings& s, Size sz) {
     setWindowProperty(settings->MAIN_WINDOW, CV_WND_PROP_FULLSCREEN, CV_WINDOW_FULLSCREEN);
 }
 
-UserInterface::UserInterface(const UserInterface& orig) {
-}
-
 UserInterface::~UserInterface() {
+
+    // Windows would otherwise outlive the tracker and keep calling back into it
+    destroyWindow(UserInterface::settings->MAIN_WINDOW);
+    destroyWindow("Histogram");
 }
 
 /**
@@ -44,11 +45,13 @@ UserInterface::~UserInterface() {
  */
 void UserInterface::on_trackbar(int, void*) {
 
+#ifndef PROFILE_BLUR_KERNEL_SIZE
     // Gaussian kernel size must be positive and odd. Or, it can be zero’s and
     // then it is computed from sigma.
     if (UserInterface::settings->blur_kernel_size % 2 == 0) {
         UserInterface::settings->blur_kernel_size++;
     }
+#endif
 
     // Erode size cannot be 0
     if (UserInterface::settings->erode_size == 0) {
@@ -78,8 +81,10 @@ void UserInterface::create_main_window() {
     createTrackbar("V Min", UserInterface::settings->MAIN_WINDOW, &UserInterface::settings->value_min, 255, on_trackbar);
     createTrackbar("V Max", UserInterface::settings->MAIN_WINDOW, &UserInterface::settings->value_max, 255, on_trackbar);
 
-    // Gaussian blur trackbar
+#ifndef PROFILE_BLUR_KERNEL_SIZE
+    // Gaussian blur trackbar, the blur of a build profile is fixed
     createTrackbar("Blur", UserInterface::settings->MAIN_WINDOW, &UserInterface::settings->blur_kernel_size, min(UserInterface::video_size.height, UserInterface::video_size.width), on_trackbar);  
+#endif
 
 }
 
@@ -137,88 +142,6 @@ void UserInterface::onMouse(int event, int x, int y, int flags, void*) {
     }
 }
 
-/**
- * Draws position of the object as crosshairs with the center in the object's
- * centroid.
- * 
- * @param x x coordinate
- * @param y y coordinate
- * @param radius radius of crosshairs
- * @param frame frame to which draw into
- */
-void UserInterface::draw_position(int x, int y, double radius, Mat &frame) {
-
-    // Lines
-    if (y - radius > 0) {
-        line(frame, Point(x, y), Point(x, y - radius), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
-    } else {
-        line(frame, Point(x, y), Point(x, 0), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
-    }
-
-    if (y + radius < UserInterface::video_size.height) {
-        line(frame, Point(x, y), Point(x, y + radius), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
-    } else {
-        line(frame, Point(x, y), Point(x, UserInterface::video_size.height), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
-    }
-
-    if (x - radius > 0) {
-        line(frame, Point(x, y), Point(x - radius, y), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
-    } else {
-        line(frame, Point(x, y), Point(0, y), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
-    }
-
-    if (x + radius < UserInterface::video_size.width) {
-        line(frame, Point(x, y), Point(x + radius, y), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
-    } else {
-        line(frame, Point(x, y), Point(UserInterface::video_size.width, y), UserInterface::settings->LOCATION_COLOR, UserInterface::settings->LOCATION_THICKNESS);
-    }
-
-    // Text coordinates
-    putText(frame, "[" + int_to_string(x) + "," + int_to_string(y) + "]", Point(x, y + radius + 20), 1, 1, UserInterface::settings->LOCATION_COLOR, 1, 8);
-}
-
-/**
- * Prints current status to the GUI.
- * 
- * @param frame
- * @param status
- * @param time_to_target
- */
-void UserInterface::print_status(Mat& frame, int status) {
-
-    String stringStatus;
-
-    switch (status) {
-        case 0:
-            stringStatus = "Initialization";
-            break;
-        case 1:
-            stringStatus = "Select EMILY and target.";
-            break;
-        case 2:
-            stringStatus = "Target set. Getting orientation.";
-            break;
-        case 3:
-            stringStatus = "Target set. Going to target.";
-            break;
-    }
-
-    // Print status
-    putText(frame, stringStatus, Point(50, 50), FONT_HERSHEY_SIMPLEX, 1, Scalar(0, 0, 255), 2);
-}
-
-/**
- * Convert integer to string.
- * 
- * @param number integer to be converted to string
- * 
- */
-string UserInterface::int_to_string(int number) {
-    stringstream stringStream;
-    stringStream << number;
-    return stringStream.str();
-}
-
 /**
  * Show main window.
  * 
@@ -20,13 +20,10 @@ class UserInterface {
 public:
 
     UserInterface(Settings&, Size);
-    UserInterface(const UserInterface& orig);
+    UserInterface(const UserInterface& orig) = delete;
+    UserInterface& operator=(const UserInterface& orig) = delete;
     virtual ~UserInterface();
     
-    void draw_position(int, int, double, Mat&);
-    
-    void print_status(Mat&, int);
-    
     void show_main(Mat&);
     
     void show_histogram(Mat&);
@@ -39,8 +36,6 @@ private:
     
     static void on_trackbar(int, void*);
     
-    string int_to_string(int);
-    
     // Program settings
     static Settings * settings;
     
@@ -9,6 +9,52 @@
 
 VictimTracker::VictimTracker() {
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Threads
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Before the video source is opened, so its decoder threads and the
+    // OpenCV pool inherit the placement
+    ThreadPlacement thread_placement(* settings);
+    thread_placement.apply(THREAD_PROCESSING);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Input
+    ////////////////////////////////////////////////////////////////////////////
+
+    frame_ring.reset(new SharedFrameRing());
+
+    if (settings->use_frame_server) {
+
+        // Wait until the frame server creates the shared memory
+        int waited_seconds = 0;
+
+        while (!frame_ring->attach(settings->shared_frames_name)) {
+
+            if (waited_seconds >= settings->shared_frames_attach_seconds) {
+                cout << "No frame server " << settings->shared_frames_name << " after " << waited_seconds << " s" << endl;
+                exit(EXIT_FAILURE);
+            }
+
+            cout << "Waiting for frame server " << settings->shared_frames_name << endl;
+            sleep(1);
+            waited_seconds++;
+        }
+
+    } else {
+
+        stream_supervisor.reset(new StreamSupervisor(* settings));
+        stream_supervisor->open(settings->video_capture_source);
+
+        // Size and frame rate are only known from a frame, so a stream which
+        // is down at startup is waited for like one which dropped later
+        if (!stream_supervisor->wait_for_frame()) {
+            cout << "No frames from " << settings->video_capture_source << endl;
+            exit(EXIT_FAILURE);
+        }
+
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // Output video initialization
     //////////////////////////////////////////////////////////////////////////// 
@@ -27,6 +73,54 @@ VictimTracker::VictimTracker() {
     // Get the size of input video
     get_input_video_size();
 
+    initialize(input_video_fps, SINK_ALL);
+
+    // Keep the clean source next to the track. Frames from the frame server
+    // may be skipped, so they cannot be matched to the source file.
+    if (track_recorder != NULL && settings->recording_mode == RECORDING_SOURCE && !settings->use_frame_server) {
+        track_recorder->copy_source(settings->video_capture_source);
+
+        // Threads ffmpeg starts later inherit the placement of its main thread
+        if (track_recorder->get_copy_process() > 0) {
+            thread_placement.apply(THREAD_IO, track_recorder->get_copy_process());
+        }
+    }
+
+}
+
+/**
+ * Create tracker for frames pushed by the host with push. Nothing is read
+ * from the video source in Settings. With the user interface output the
+ * host has to call waitKey for the window to refresh.
+ * 
+ * @param frame_size size of pushed frames
+ * @param fps frame rate written to the recording
+ * @param sink_flags combination of TrackerSink flags
+ */
+VictimTracker::VictimTracker(Size frame_size, double fps, int sink_flags) {
+
+    // Before the first parallel loop, so the OpenCV pool inherits the placement
+    ThreadPlacement thread_placement(* settings);
+    thread_placement.apply(THREAD_PROCESSING);
+
+    frame_ring.reset(new SharedFrameRing());
+
+    set_input_video_size(frame_size);
+
+    initialize(fps > 0 ? fps : 7, sink_flags);
+
+}
+
+/**
+ * Create outputs and processing objects.
+ * 
+ * @param input_video_fps
+ * @param sink_flags combination of TrackerSink flags
+ */
+void VictimTracker::initialize(double input_video_fps, int sink_flags) {
+
+    sinks = sink_flags;
+
     // Output video name. It is in format year_month_day_hour_minute_second.avi.
     time_t raw_time;
     time(&raw_time);
@@ -36,23 +130,78 @@ VictimTracker::VictimTracker() {
     strftime(output_file_name, 40, "output/%Y_%m_%d_%H_%M_%S", local_time);
     string output_file_name_string(output_file_name);
 
-    OutputVideo * output_video = new OutputVideo(input_video_fps, resized_video_size, output_file_name_string);
-    video_writer = output_video->get_video_writer();
+    if ((sinks & SINK_RECORDING) && settings->recording_mode == RECORDING_ANNOTATED) {
+        OutputVideo output_video(input_video_fps, resized_video_size, output_file_name_string);
+        video_writer = output_video.get_video_writer();
+    } else if (sinks & SINK_RECORDING) {
+        track_recorder.reset(new TrackRecorder(output_file_name_string, input_frame_size, input_video_fps));
+    }
+
+    overlay.reset(new Overlay(* settings, resized_video_size));
 
     ////////////////////////////////////////////////////////////////////////////
     // Log
     ////////////////////////////////////////////////////////////////////////////
 
-    logger = new Logger(output_file_name_string);
+    logger.reset((sinks & SINK_LOG) ? new Logger(output_file_name_string) : NULL);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Tracing
+    ////////////////////////////////////////////////////////////////////////////
+
+    trace_file_name = output_file_name_string + ".trace.json";
+
+    if (settings->tracing) {
+        Tracer::enable(settings->trace_buffer_events);
+        Tracer::dump_on_signal(SIGUSR1);
+        Tracer::name_thread("vision");
+    }
+
+    latency_probe.reset(settings->latency_probe ? new LatencyProbe(* settings) : NULL);
 
     ////////////////////////////////////////////////////////////////////////////
     // GUI
     ////////////////////////////////////////////////////////////////////////////
 
 #ifdef USER_INTERFACE
-    user_interface = new UserInterface(* settings, resized_video_size);
+    user_interface.reset((sinks & SINK_USER_INTERFACE) ? new UserInterface(* settings, resized_video_size) : NULL);
 #endif
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Pipeline
+    ////////////////////////////////////////////////////////////////////////////
+
+    frame_pipeline.reset(new FramePipeline(* settings));
+
+    integral_camshift.reset(new IntegralCamShift());
+    integral_camshift->set_integer_arithmetic(settings->integer_tracking);
+
+    particle_tracker.reset(new ParticleTracker(* settings));
+
+    change_detector.reset(new FrameChangeDetector(* settings));
+
+    horizon_detector.reset(new HorizonDetector(* settings));
+
+    ego_motion_estimator.reset(new EgoMotionEstimator(* settings));
+
+    resolution_controller.reset(new ResolutionController(* settings));
+
+    // Frames from the frame server are resized while reading and undistorted
+    // frames exist only in processing resolution
+    if (settings->use_frame_server || settings->undistort_frame) {
+        resolution_controller->set_sizes(resized_video_size, resized_video_size);
+    } else {
+        resolution_controller->set_sizes(input_frame_size, resized_video_size);
+    }
+
+    blob_detector.reset(new BlobDetector(* settings));
+
+    camera_model.reset(new CameraModel(* settings, resized_video_size));
+
+    color_model.reset(new ColorModel(* settings));
+
+    result_channel.reset(new ResultChannel(settings->result_history_size));
+
     ////////////////////////////////////////////////////////////////////////////
     // Histogram
     ////////////////////////////////////////////////////////////////////////////
@@ -61,15 +210,23 @@ VictimTracker::VictimTracker() {
     histogram_ranges[0] = 0;
     histogram_ranges[1] = 180;
 
-    // Histogram for red
-    histogram = (Mat_<float>(16, 1) << 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255);
-
-    // Histogram for yellow
-    //histogram = (Mat_<float>(16, 1) << 0, 0, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    // Histogram for red or yellow jacket
+    histogram = ColorModel::preset_histogram(settings->color_preset);
 
     // Normalize histogram
     normalize(histogram, histogram, 0, 255, NORM_MINMAX);
 
+    // Adapt from the preset
+    color_model->set_base(histogram);
+
+    // Build back projection kernel for the histogram
+    back_projector.set_histogram(histogram, histogram_size, histogram_ranges);
+
+    // Build the BGR table of the preset before the first frame
+    if (settings->bgr_lookup_table) {
+        frame_pipeline->prepare(back_projector);
+    }
+
     // Initialize object of interest to be in the top left corner
     // It does not matter that the object is not there. The algorithm will find it.
     object_of_interest = Rect(0, 0, 20, 20);
@@ -79,13 +236,85 @@ VictimTracker::VictimTracker() {
 
 }
 
-VictimTracker::VictimTracker(const VictimTracker& orig) {
-}
-
 VictimTracker::~VictimTracker() {
 
     // Close logs
-    delete VictimTracker::logger;
+    logger.reset();
+
+    // Close track and stop copying the source
+    track_recorder.reset();
+    overlay.reset();
+
+    // Detach from the frame server
+    frame_ring.reset();
+
+    // Report outages and close the video source
+    if (stream_supervisor != NULL) {
+        stream_supervisor->print_statistics();
+    }
+    stream_supervisor.reset();
+
+    // Release pipeline buffers
+    frame_pipeline.reset();
+
+    // Release integral images
+    integral_camshift.reset();
+
+    // Release particles
+    particle_tracker.reset();
+
+    // Report skipped frames
+    change_detector->print_statistics();
+    change_detector.reset();
+
+    // Report rows skipped above the horizon
+    if (settings->horizon_detection) {
+        horizon_detector->print_statistics();
+    }
+    horizon_detector.reset();
+
+    // Report camera motion
+    if (settings->ego_motion_compensation) {
+        ego_motion_estimator->print_statistics();
+    }
+    ego_motion_estimator.reset();
+
+    // Report time spent at each tracking resolution
+    if (settings->adaptive_resolution) {
+        resolution_controller->print_statistics();
+    }
+    resolution_controller.reset();
+
+    // Release blob detection buffers
+    blob_detector.reset();
+
+    // Release undistortion maps
+    camera_model.reset();
+
+    color_model.reset();
+
+    result_channel.reset();
+
+    // Report frame age
+    if (latency_probe != NULL) {
+        latency_probe->print_report();
+    }
+    latency_probe.reset();
+
+#ifdef USER_INTERFACE
+    // Close windows
+    user_interface.reset();
+#endif
+
+    delete[] VictimTracker::emily_location_history;
+
+    // Nothing uses settings past this point
+    delete VictimTracker::settings;
+
+    // Write the timeline
+    if (Tracer::is_enabled()) {
+        Tracer::dump(trace_file_name);
+    }
 
     // Announce that the processing was finished
     cout << "Processing finished!" << endl;
@@ -98,36 +327,34 @@ VictimTracker::~VictimTracker() {
  * @return Frame per seconds
  */
 double VictimTracker::get_input_video_fps() {
-    double input_video_fps = video_capture.get(CV_CAP_PROP_FPS);
+    double input_video_fps = settings->use_frame_server ? frame_ring->get_fps() : stream_supervisor->get(CV_CAP_PROP_FPS);
 
     // If the input is video stream, we have to calculate FPS manually
-    if (input_video_fps == 0) {
+    if (input_video_fps <= 0 && stream_supervisor != NULL) {
 
         // Number of sample frames to capture
         int num_sample_frames = 50;
 
-        // Start and end times
-        time_t start, end;
-
         // Sample video frame
         Mat sample_frame;
 
         // Start timer
-        time(&start);
-
-        // Load sample frames
-        for (int i = 0; i < num_sample_frames; i++) {
-            video_capture >> sample_frame;
+        int64 start = getTickCount();
+
+        // Load sample frames. Only frames which arrived count, reads while
+        // the stream is down return empty.
+        int frames = 0;
+        while (frames < num_sample_frames && !stream_supervisor->has_ended()) {
+            if (stream_supervisor->read(sample_frame)) {
+                frames++;
+            }
         }
 
-        // End timer
-        time(&end);
-
         // Compute elapsed time
-        double time_difference = difftime(end, start);
+        double time_difference = (getTickCount() - start) / getTickFrequency();
 
         // Calculate frames per second
-        input_video_fps = num_sample_frames / time_difference;
+        input_video_fps = (frames > 1 && time_difference > 0) ? (frames - 1) / time_difference : 7;
 
         // The maximum frame rate from MPEG 4 is 65.535
         if (input_video_fps > 65.535) {
@@ -139,12 +366,68 @@ double VictimTracker::get_input_video_fps() {
     return input_video_fps;
 }
 
+/**
+ * Read the next frame from the video source or from the frame server.
+ * 
+ * Shared frames are read-only and drawn into later, so they are taken out
+ * of shared memory exactly once, by the resize if it is needed and by a
+ * copy otherwise. Nothing else reads the shared memory. A frame that the
+ * server overwrote during that copy is returned as empty.
+ * 
+ * @param frame
+ */
+void VictimTracker::read_frame(Mat& frame) {
+
+    if (!settings->use_frame_server) {
+
+        stream_supervisor->read(frame);
+
+        // A reconnected stream may come back in another resolution
+        if (!frame.empty() && input_frame_size.area() > 0 && frame.size() != input_frame_size) {
+            resize(frame, frame, input_frame_size, 0, 0, INTER_AREA);
+        }
+
+        return;
+    }
+
+    Mat shared_frame;
+    uint64_t sequence;
+
+    if (!frame_ring->acquire(shared_frame, sequence, settings->shared_frames_timeout_ms)) {
+        frame.release();
+        return;
+    }
+
+    if (resize_video) {
+        resize(shared_frame, frame, resized_video_size, 0, 0, INTER_LANCZOS4);
+    } else {
+        shared_frame.copyTo(frame);
+    }
+
+    if (!frame_ring->is_valid(sequence)) {
+        frame.release();
+    }
+
+}
+
 /**
  * Get the resolution of the input video feed.
  */
 void VictimTracker::get_input_video_size() {
 
-    Size input_video_size(video_capture.get(CV_CAP_PROP_FRAME_WIDTH), video_capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+    Size input_video_size = settings->use_frame_server ? frame_ring->get_size() : stream_supervisor->get_frame_size();
+
+    set_input_video_size(input_video_size);
+}
+
+/**
+ * Set processing resolution for the given input resolution.
+ * 
+ * @param input_video_size
+ */
+void VictimTracker::set_input_video_size(Size input_video_size) {
+
+    input_frame_size = input_video_size;
 
     // If the input video exceeds processing video size limits, we will have to resize it
     if (input_video_size.height > settings->PROCESSING_VIDEO_HEIGHT_LIMIT) {
@@ -178,18 +461,9 @@ void VictimTracker::get_input_video_size() {
         resize_video = false;
 
     }
-}
 
-/**
- * Equalize histogram of the given frame.
- * 
- * @param HSV_frame
- */
-void VictimTracker::equalize(Mat& HSV_frame) {
-    vector<Mat> HSV_planes;
-    split(HSV_frame, HSV_planes);
-    equalizeHist(HSV_planes[2], HSV_planes[2]);
-    merge(HSV_planes, HSV_frame);
+    // Results are reported in input resolution
+    input_scale = resized_video_size.width > 0 ? (double) input_video_size.width / resized_video_size.width : 1;
 }
 
 /**
@@ -214,15 +488,21 @@ void VictimTracker::create_histogram(Rect& object_of_interest, int& histogram_si
     // Calculate histogram of region of interest
     calcHist(&region_of_interest, 1, 0, region_of_interest_mask, histogram, 1, &histogram_size, &pointer_histogram_ranges);
 
-    // Print histogram
-    cout << histogram << endl;
-
     // Normalize histogram
     normalize(histogram, histogram, 0, 255, NORM_MINMAX);
 
+    // Selection replaces the base of the adapted model
+    color_model->set_base(histogram);
+
+    // Rebuild back projection kernel for the new histogram
+    back_projector.set_histogram(histogram, histogram_size, pointer_histogram_ranges);
+
     // Set object of interest to selection
     object_of_interest = selection;
 
+    // Forget hypotheses about the previous victim
+    particle_tracker->reset(object_of_interest);
+
     // Begin tracking object
     object_selected = 1;
 
@@ -292,16 +572,352 @@ void VictimTracker::update_history() {
     emily_location_history_pointer = (emily_location_history_pointer + 1) % settings->EMILY_LOCATION_HISTORY_SIZE;
 }
 
+/**
+ * Get motion of the victim between the last two frames.
+ *
+ * @return
+ */
+Point VictimTracker::get_victim_motion() {
+
+    int size = settings->EMILY_LOCATION_HISTORY_SIZE;
+
+    Point last = emily_location_history[(emily_location_history_pointer - 1 + size) % size];
+    Point before_last = emily_location_history[(emily_location_history_pointer - 2 + size) % size];
+
+    // The window is already moved with the camera, so only motion of the
+    // victim in the water is left
+    if (settings->ego_motion_compensation) {
+        return last - before_last - Point(cvRound(previous_camera_motion.x), cvRound(previous_camera_motion.y));
+    }
+
+    return last - before_last;
+}
+
 /**
  * Show current object of interest selection in the GUI.
  */
 void VictimTracker::show_selection() {
     if (select_object && selection.width > 0 && selection.height > 0) {
-        Mat roi(original_frame, selection);
+        Mat roi(output_frame, selection & Rect(0, 0, output_frame.cols, output_frame.rows));
         bitwise_not(roi, roi);
     }
 }
 
+/**
+ * Choose the tracking resolution and build the tracking frame. Without
+ * adaptive resolution the processing frame is tracked.
+ * 
+ * @param search whether the whole frame has to be searched for the victim
+ */
+void VictimTracker::select_tracking_level(bool search) {
+
+    if (!settings->adaptive_resolution) {
+        tracking_frame = original_frame;
+        return;
+    }
+
+    TraceScope trace("select_level");
+
+    if (search) {
+        resolution_controller->search();
+    } else {
+        resolution_controller->select(min(victim_size.width, victim_size.height));
+    }
+
+    set_tracking_scale(resolution_controller->get_scale());
+
+    resolution_controller->build(source_frame, original_frame, tracking_frame);
+}
+
+/**
+ * Move the search window and the last CamShift result to a new tracking
+ * resolution.
+ * 
+ * @param scale ratio of tracking to processing resolution
+ */
+void VictimTracker::set_tracking_scale(double scale) {
+
+    if (scale == tracking_scale) {
+        return;
+    }
+
+    double ratio = scale / tracking_scale;
+
+    object_of_interest = Rect(cvRound(object_of_interest.x * ratio), cvRound(object_of_interest.y * ratio), cvRound(object_of_interest.width * ratio), cvRound(object_of_interest.height * ratio));
+
+    tracking_result.window = object_of_interest;
+    tracking_result.box.center *= ratio;
+    tracking_result.box.size.width *= ratio;
+    tracking_result.box.size.height *= ratio;
+
+    particle_tracker->scale(ratio);
+
+    tracking_scale = scale;
+}
+
+/**
+ * Move the search window and the particles with the image shift of the
+ * current frame.
+ */
+void VictimTracker::compensate_camera_motion() {
+
+    Point shift(cvRound(camera_motion.x * tracking_scale), cvRound(camera_motion.y * tracking_scale));
+
+    if (shift == Point()) {
+        return;
+    }
+
+    object_of_interest += shift;
+
+    particle_tracker->translate(Point2f(shift));
+}
+
+/**
+ * Get the last CamShift result in processing resolution.
+ * 
+ * @return 
+ */
+RotatedRect VictimTracker::get_tracking_box() {
+
+    RotatedRect box = tracking_result.box;
+
+    box.center *= 1. / tracking_scale;
+    box.size.width /= tracking_scale;
+    box.size.height /= tracking_scale;
+
+    return box;
+}
+
+/**
+ * Run the pipeline and CamShift on the current frame.
+ * 
+ * @param frame_change how much the frame changed since the last processed frame
+ */
+void VictimTracker::track_victim(FrameChange frame_change) {
+
+    Rect frame_rectangle(0, 0, tracking_frame.cols, tracking_frame.rows);
+
+    // Victims are in the water, so rows above the horizon are never processed
+    if (settings->horizon_detection) {
+        int water_top = horizon_detector->get_water_top(tracking_frame.rows);
+        frame_rectangle = Rect(0, water_top, tracking_frame.cols, tracking_frame.rows - water_top);
+    }
+
+    // Region to process
+    Rect region = frame_rectangle;
+
+    // Resolutions finer than the processing resolution pay only for the
+    // surroundings of the victim
+    bool region_only = settings->adaptive_resolution && resolution_controller->is_region_only();
+
+    // The whole frame is still processed every change_full_frame_interval
+    // frames, so equalization follows the scene and other victims are seen
+    bool whole_frame_refresh = region_only && region_only_frames + 1 >= settings->change_full_frame_interval;
+
+    if (whole_frame_refresh) {
+        region_only = false;
+        region_only_frames = 0;
+    } else if (region_only) {
+        region_only_frames++;
+    }
+
+    // The frame changed a little, so process a region of three search
+    // windows around the victim
+    if (!whole_frame_refresh && (frame_change == FRAME_SMALL_CHANGE || region_only)) {
+        int margin_x = max(object_of_interest.width, settings->change_region_margin);
+        int margin_y = max(object_of_interest.height, settings->change_region_margin);
+        region = Rect(object_of_interest.x - margin_x, object_of_interest.y - margin_y, object_of_interest.width + 2 * margin_x, object_of_interest.height + 2 * margin_y) & frame_rectangle;
+    }
+
+    // Print pipeline scaling once on real data
+    if (settings->report_pipeline_scaling && !pipeline_scaling_reported) {
+        frame_pipeline->report_scaling(tracking_frame, back_projector);
+        pipeline_scaling_reported = true;
+    }
+
+    // Hue and threshold planes are only needed to create a histogram
+    frame_pipeline->set_retain_planes(object_selected < 0);
+
+    // Blur, convert to HSV, equalize on value (V), threshold on
+    // saturation and value but not on hue, and back project. Small
+    // changes and regions at fine resolution keep the equalization of the
+    // last whole frame.
+    {
+        TraceScope trace("pipeline");
+        frame_pipeline->process(tracking_frame, region, back_projector, back_projection, whole_frame_refresh || (frame_change == FRAME_CHANGED && !region_only));
+    }
+
+    hue = frame_pipeline->get_hue();
+    saturation_value_threshold = frame_pipeline->get_saturation_value_threshold();
+
+    // Uncomment this only if histogram should be created automatically
+    //                // Object does not have histogram yet, so create it
+    //                if (object_selected < 0) {
+    //
+    //                    // Create histogram of region of interest
+    //                    create_histogram(object_of_interest, histogram_size, pointer_histogram_ranges, hue, saturation_value_threshold, histogram, histogram_image);
+    //
+    //                }
+
+    // Integral images make every mean shift step O(1)
+    if (settings->integral_camshift || settings->integer_tracking || settings->particle_tracking) {
+        integral_camshift->set_image(back_projection, region);
+    }
+
+    // CamShift algorithm
+    run_camshift();
+
+    // An adapted model may have drifted to the background, so the next
+    // frames use the base model again
+    if (is_track_lost() && color_model->is_adapted()) {
+        color_model->reset();
+        apply_color_model();
+    }
+
+    // Track is lost, so search the whole frame for the victim
+    if (settings->blob_reacquisition && is_track_lost()) {
+
+        // Back projection is only known inside of the region
+        if (region != frame_rectangle) {
+
+            // Fine resolution is never processed whole, so search at the
+            // processing resolution
+            if (region_only) {
+                select_tracking_level(true);
+            }
+
+            track_victim(FRAME_CHANGED);
+            return;
+        }
+
+        TraceScope trace("reacquisition");
+
+        // Reseed CamShift at the best blob
+        vector<Blob> blobs = blob_detector->detect(back_projection);
+
+        if (!blobs.empty()) {
+            object_of_interest = blobs[0].bounding_box;
+            run_camshift();
+        }
+
+    }
+
+    // Learn the appearance of the victim from a confident track
+    if (settings->color_adaptation && !is_track_lost() && tracking_result.converged && tracking_result.confidence >= settings->color_adaptation_min_confidence) {
+        adapt_color_model();
+    }
+
+    // Object of interest are is too small, so inflate the tracking box
+    if (object_of_interest.area() <= 1) {
+        int cols = back_projection.cols;
+        int rows = back_projection.rows;
+        int new_rectangle_size = (MIN(cols, rows) + 5) / 6;
+        object_of_interest = Rect(object_of_interest.x - new_rectangle_size, object_of_interest.y - new_rectangle_size, object_of_interest.x + new_rectangle_size, object_of_interest.y + new_rectangle_size) & Rect(0, 0, cols, rows);
+    }
+}
+
+/**
+ * Blend the hue histogram from inside of the tracking box into the model.
+ * Only the square inscribed in the tracking ellipse is read, so background
+ * at the corners of the box is not learned.
+ */
+void VictimTracker::adapt_color_model() {
+
+    TraceScope trace("color_adaptation");
+
+    RotatedRect box = tracking_result.box;
+
+    int side = cvRound(min(box.size.width, box.size.height) / sqrt(2.));
+
+    if (side <= 0) {
+        return;
+    }
+
+    Rect inner(cvRound(box.center.x) - side / 2, cvRound(box.center.y) - side / 2, side, side);
+
+    Mat observed;
+    int pixels = frame_pipeline->hue_histogram(inner, histogram_size, pointer_histogram_ranges, observed);
+
+    if (color_model->adapt(observed, pixels)) {
+        apply_color_model();
+    }
+}
+
+/**
+ * Use the current histogram of the color model for back projection.
+ */
+void VictimTracker::apply_color_model() {
+
+    color_model->get_histogram().copyTo(histogram);
+
+    back_projector.set_histogram(histogram, histogram_size, pointer_histogram_ranges);
+}
+
+/**
+ * Run CamShift from the current object of interest.
+ */
+void VictimTracker::run_camshift() {
+
+    TraceScope trace("camshift");
+
+    TermCriteria camshift_criteria(TermCriteria::EPS | TermCriteria::COUNT, 10, 1);
+
+    if (settings->particle_tracking) {
+
+        // Particles are already moved by the last victim motion, so
+        // CamShift refines the strongest mode only
+        Point motion = get_victim_motion() * tracking_scale;
+
+        particle_result = particle_tracker->track(* integral_camshift, object_of_interest, Point2f(motion));
+
+        vector<Rect> candidates;
+        candidates.push_back(particle_result.window);
+
+        tracking_result = integral_camshift->track(candidates, camshift_criteria);
+        object_of_interest = tracking_result.window;
+
+        // Competing modes lower the confidence
+        if (tracking_result.box.size.width > 0 && tracking_result.box.size.height > 0) {
+            tracking_result.confidence = particle_result.confidence;
+        }
+
+    } else if (settings->integral_camshift || settings->integer_tracking) {
+
+        // Start from the last window and from the last window moved by the last victim motion
+        vector<Rect> candidates;
+        candidates.push_back(object_of_interest);
+
+        Point motion = get_victim_motion() * tracking_scale;
+        if (motion != Point()) {
+            candidates.push_back(object_of_interest + motion);
+        }
+
+        tracking_result = integral_camshift->track(candidates, camshift_criteria);
+        object_of_interest = tracking_result.window;
+
+    } else {
+
+        tracking_result = CamShiftResult();
+        tracking_result.box = CamShift(back_projection, object_of_interest, camshift_criteria);
+        tracking_result.window = object_of_interest;
+
+        // OpenCV does not report convergence, so only presence of the box is known
+        tracking_result.confidence = (tracking_result.box.size.width > 0 && tracking_result.box.size.height > 0) ? 1 : 0;
+
+    }
+}
+
+/**
+ * Check whether CamShift lost the victim.
+ * 
+ * @return 
+ */
+bool VictimTracker::is_track_lost() {
+
+    return tracking_result.box.size.width <= 0 || tracking_result.box.size.height <= 0 || object_of_interest.area() <= 1 || tracking_result.confidence < settings->lost_confidence;
+
+}
+
 /**
  * Call in each iteration to track the victim.
  * 
@@ -313,10 +929,19 @@ int VictimTracker::logic() {
     if (!paused) {
 
         // Read one frame
-        video_capture >> original_frame;
+        {
+            TraceScope trace("read_frame");
+            read_frame(input_frame);
+        }
 
         // End if frame is empty for long time
-        if (original_frame.empty()) {
+        if (input_frame.empty()) {
+
+            // The supervisor sleeps while the stream is down and reports
+            // when it ended for good
+            if (stream_supervisor != NULL) {
+                return stream_supervisor->has_ended() ? -1 : 0;
+            }
 
             empty_frame_counter++;
 
@@ -334,26 +959,99 @@ int VictimTracker::logic() {
 
     }
 
+    // Track, show and record. The last frame is pushed again while paused.
+    push(input_frame);
+
+    char character;
+    {
+        TraceScope trace("wait_key");
+        character = (char) waitKey(10);
+    }
+    
+    if (character == 27)
+        
+        return -1;
+    
+    switch (character) {
+        case 'b':
+
+            // Toggle back projection mode
+            back_projection_mode = !back_projection_mode;
+
+            break;
+        case 'c':
+
+            // Stop tracking
+            object_selected = 0;
+            //histogram_image = Scalar::all(0);
+
+            break;
+        case 'p':
+
+            // Toggle pause
+            paused = !paused;
+
+            break;
+        case 'r':
+
+            // Roll the color model back to the base
+            color_model->reset();
+            apply_color_model();
+
+            break;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Track the victim in a frame owned by the caller. The frame is only read,
+ * never copied unless it has to be resized or undistorted.
+ * 
+ * @param frame BGR frame of the size given in the constructor
+ * @return 
+ */
+TrackingResult VictimTracker::push(const Mat& frame) {
+
+    int64 start = getTickCount();
+
+    TrackingResult result;
+    result.frame_number = frame_number;
+    result.timestamp = Tracer::now();
+
+    Tracer::set_frame(frame_number);
+    TraceScope trace("push");
+
+    // Frames pushed again while paused keep their number
+    if (!paused) {
+        frame_number++;
+    }
+
     ////////////////////////////////////////////////////////////////////////
     // Preprocessing
     ////////////////////////////////////////////////////////////////////////
 
-    if (resize_video) {
+    original_frame = frame;
+
+    // Frames from the frame server are resized while reading
+    if (resize_video && original_frame.size() != resized_video_size) {
 
         // Resize the input
-        resize(original_frame, original_frame, resized_video_size, 0, 0, INTER_LANCZOS4);
+        TraceScope trace("resize");
+        resize(frame, original_frame, resized_video_size, 0, 0, INTER_LANCZOS4);
 
     }
 
-    // Apply Gaussian blur filter
-    GaussianBlur(original_frame, blured_frame, Size(settings->blur_kernel_size, settings->blur_kernel_size), 0, 0);
+    if (settings->undistort_frame) {
 
-    // Convert to HSV color space
-    Mat HSV_frame;
-    cvtColor(blured_frame, HSV_frame, COLOR_BGR2HSV);
+        // Remove lens distortion from the whole frame
+        TraceScope trace("undistort");
+        camera_model->undistort_frame(original_frame);
 
-    // Equalize on value (V)
-    equalize(HSV_frame);
+    }
+
+    source_frame = settings->undistort_frame ? original_frame : frame;
 
     ////////////////////////////////////////////////////////////////////////
     // Thresholding
@@ -363,53 +1061,54 @@ int VictimTracker::logic() {
 
         if (object_selected) {
 
-            // Threshold on saturation and value, but not on hue
-            inRange(HSV_frame, Scalar(0, settings->saturation_min, settings->value_min), Scalar(180, settings->saturation_max, settings->value_max), saturation_value_threshold);
-
-            // Mix channels
-            int chanels[] = {0, 0};
-            hue.create(HSV_frame.size(), HSV_frame.depth());
-            mixChannels(&HSV_frame, 1, &hue, 1, chanels, 1);
-
-            // Uncomment this only if histogram should be created automatically
-            //                // Object does not have histogram yet, so create it
-            //                if (object_selected < 0) {
-            //
-            //                    // Create histogram of region of interest
-            //                    create_histogram(object_of_interest, histogram_size, pointer_histogram_ranges, hue, saturation_value_threshold, histogram, histogram_image);
-            //
-            //                }
-
-            // Calculate back projection
-            calcBackProject(&hue, 1, 0, histogram, back_projection, &pointer_histogram_ranges);
-
-            // Apply back projection on saturation value threshold
-            back_projection &= saturation_value_threshold;
-
-            // CamShift algorithm
-            RotatedRect tracking_box = CamShift(back_projection, object_of_interest, TermCriteria(TermCriteria::EPS | TermCriteria::COUNT, 10, 1));
-
-            // Object of interest are is too small, so inflate the tracking box
-            if (object_of_interest.area() <= 1) {
-                int cols = back_projection.cols;
-                int rows = back_projection.rows;
-                int new_rectangle_size = (MIN(cols, rows) + 5) / 6;
-                object_of_interest = Rect(object_of_interest.x - new_rectangle_size, object_of_interest.y - new_rectangle_size, object_of_interest.x + new_rectangle_size, object_of_interest.y + new_rectangle_size) & Rect(0, 0, cols, rows);
+            // Frames that are not processed do not move the camera
+            previous_camera_motion = camera_motion;
+            camera_motion = Point2f();
+
+            // Decide how much of the frame has to be processed
+            FrameChange frame_change = FRAME_CHANGED;
+
+            if (settings->change_detection) {
+                TraceScope trace("change_detection");
+                frame_change = change_detector->classify(original_frame, object_selected > 0 && tracking_result.confidence > 0);
             }
 
-            // We are in back projection mode
-            if (back_projection_mode) {
-                cvtColor(back_projection, original_frame, COLOR_GRAY2BGR);
+            // Frames that did not change reuse the previous tracking result
+            if (frame_change != FRAME_STATIC) {
+
+                // Refresh the water region every few processed frames
+                if (settings->horizon_detection) {
+                    TraceScope trace("horizon");
+                    horizon_detector->update(original_frame);
+                }
+
+                // Pitch and roll shift the whole image, so the window
+                // starts where the victim moved with it
+                if (settings->ego_motion_compensation) {
+                    TraceScope trace("ego_motion");
+                    if (ego_motion_estimator->estimate(original_frame, camera_motion)) {
+                        compensate_camera_motion();
+                    }
+                }
+
+                // Tracking resolution for the victim size of the last frame
+                select_tracking_level(is_track_lost());
+
+                TraceScope trace("track");
+                track_victim(frame_change);
             }
 
-            // Draw bounding ellipse
-            if (tracking_box.size.height > 0 && tracking_box.size.width > 0) {
-                ellipse(original_frame, tracking_box, settings->LOCATION_COLOR, settings->LOCATION_THICKNESS, LINE_AA);
+            result.reused = frame_change == FRAME_STATIC;
+            result.camera_motion = camera_motion * input_scale;
 
-#ifdef USER_INTERFACE
-                // Draw cross hairs
-                user_interface->draw_position(tracking_box.center.x, tracking_box.center.y, min(tracking_box.size.width, tracking_box.size.height) / 2, original_frame);
-#endif
+            RotatedRect tracking_box = get_tracking_box();
+
+            // Undistort only the tracked points to get the bearing
+            if (settings->compute_bearing && frame_change != FRAME_STATIC) {
+                victim_bearing = camera_model->bearing(tracking_box);
+            }
+
+            if (tracking_box.size.height > 0 && tracking_box.size.width > 0) {
 
                 // Save EMILY location
                 victim_location = Point(tracking_box.center.x, tracking_box.center.y);
@@ -417,6 +1116,14 @@ int VictimTracker::logic() {
                 // Save EMILY size
                 victim_size = tracking_box.size;
 
+                result.valid = true;
+                result.center = tracking_box.center * input_scale;
+                result.size = Size2f(tracking_box.size.width * input_scale, tracking_box.size.height * input_scale);
+                result.angle = tracking_box.angle;
+                result.confidence = tracking_result.confidence;
+                result.modes = settings->particle_tracking ? particle_result.modes : 1;
+                result.bearing = victim_bearing;
+
             }
 
         }
@@ -426,71 +1133,216 @@ int VictimTracker::logic() {
         paused = false;
     }
 
-    // Show the selection
-    show_selection();
+    ////////////////////////////////////////////////////////////////////////
+    // Compute heading
+    ////////////////////////////////////////////////////////////////////////
 
-    // Show the histogram
-    //user_interface->show_histogram(histogram_image);
+    update_history();
 
-    char character = (char) waitKey(10);
-    
-    if (character == 27)
-        
-        return -1;
-    
-    switch (character) {
-        case 'b':
+    result.processing_time = (getTickCount() - start) * 1000. / getTickFrequency();
 
-            // Toggle back projection mode
-            back_projection_mode = !back_projection_mode;
+    // Readers on other threads see the result before it is drawn
+    result_channel->publish(result);
 
-            break;
-        case 'c':
+    // Age of the frame when its result became available
+    if (latency_probe != NULL) {
+        latency_probe->record(frame);
+    }
 
-            // Stop tracking
-            object_selected = 0;
-            //histogram_image = Scalar::all(0);
+    ////////////////////////////////////////////////////////////////////////
+    // Show results
+    ////////////////////////////////////////////////////////////////////////
 
-            break;
-        case 'p':
+    write_outputs(result);
 
-            // Toggle pause
-            paused = !paused;
+    // Dump the timeline if SIGUSR1 asked for it
+    if (Tracer::is_enabled()) {
+        Tracer::poll(trace_file_name);
+    }
+
+    return result;
+
+}
+
+/**
+ * Track the victim in a raw frame owned by the caller. BGR frames are
+ * wrapped without copying, other formats are converted once.
+ * 
+ * @param data first pixel
+ * @param width in pixels
+ * @param height in pixels
+ * @param stride bytes per row. YUV planes follow each other without gaps,
+ * chroma rows of NV12 have the luma stride and of I420 half of it.
+ * @param format
+ * @return 
+ */
+TrackingResult VictimTracker::push(const uchar * data, int width, int height, size_t stride, PixelFormat format) {
 
+    uchar * pixels = const_cast<uchar *> (data);
+
+    // Plane layout of a contiguous YUV buffer
+    if (format == PIXEL_FORMAT_NV12 || format == PIXEL_FORMAT_I420) {
+
+        const uchar * planes[3];
+        size_t strides[3];
+
+        planes[0] = data;
+        strides[0] = stride;
+
+        planes[1] = data + stride * height;
+        strides[1] = format == PIXEL_FORMAT_NV12 ? stride : stride / 2;
+
+        planes[2] = planes[1] + strides[1] * (height / 2);
+        strides[2] = strides[1];
+
+        return push(planes, strides, width, height, format);
+    }
+
+    switch (format) {
+        case PIXEL_FORMAT_BGR:
+            return push(Mat(height, width, CV_8UC3, pixels, stride));
+        case PIXEL_FORMAT_RGB:
+            cvtColor(Mat(height, width, CV_8UC3, pixels, stride), input_frame, COLOR_RGB2BGR);
+            break;
+        case PIXEL_FORMAT_BGRA:
+            cvtColor(Mat(height, width, CV_8UC4, pixels, stride), input_frame, COLOR_BGRA2BGR);
+            break;
+        case PIXEL_FORMAT_RGBA:
+            cvtColor(Mat(height, width, CV_8UC4, pixels, stride), input_frame, COLOR_RGBA2BGR);
+            break;
+        default:
             break;
     }
 
-    ////////////////////////////////////////////////////////////////////////
-    // Compute heading
-    ////////////////////////////////////////////////////////////////////////
+    return push(input_frame);
+}
 
-    update_history();
+/**
+ * Track the victim in a YUV frame whose planes may lie anywhere in memory,
+ * as decoders and camera drivers hand them out. The planes are packed into
+ * one buffer and converted once. Chroma is subsampled by two in both
+ * directions, so frames of odd width or height are rejected with an
+ * invalid result.
+ *
+ * @param planes luma and chroma planes. NV12 has luma and interleaved UV,
+ * I420 has luma, U and V.
+ * @param strides bytes per row of each plane
+ * @param width in pixels
+ * @param height in pixels
+ * @param format PIXEL_FORMAT_NV12 or PIXEL_FORMAT_I420
+ * @return
+ */
+TrackingResult VictimTracker::push(const uchar * const * planes, const size_t * strides, int width, int height, PixelFormat format) {
 
-    ////////////////////////////////////////////////////////////////////////
-    // Show results
-    ////////////////////////////////////////////////////////////////////////
+    if ((width & 1) || (height & 1) || width <= 0 || height <= 0 || (format != PIXEL_FORMAT_NV12 && format != PIXEL_FORMAT_I420)) {
+        return TrackingResult();
+    }
+
+    yuv_frame.create(height * 3 / 2, width, CV_8UC1);
+
+    // Luma
+    for (int y = 0; y < height; y++) {
+        memcpy(yuv_frame.ptr<uchar>(y), planes[0] + y * strides[0], width);
+    }
+
+    if (format == PIXEL_FORMAT_NV12) {
+
+        // Interleaved UV, one row per two luma rows
+        for (int y = 0; y < height / 2; y++) {
+            memcpy(yuv_frame.ptr<uchar>(height + y), planes[1] + y * strides[1], width);
+        }
+
+        cvtColor(yuv_frame, input_frame, COLOR_YUV2BGR_NV12);
+
+    } else {
+
+        // U then V, each half a row per two luma rows
+        uchar * chroma = yuv_frame.ptr<uchar>(height);
+
+        for (int plane = 1; plane <= 2; plane++) {
+            for (int y = 0; y < height / 2; y++, chroma += width / 2) {
+                memcpy(chroma, planes[plane] + y * strides[plane], width / 2);
+            }
+        }
+
+        cvtColor(yuv_frame, input_frame, COLOR_YUV2BGR_I420);
+
+    }
+
+    return push(input_frame);
+}
+
+/**
+ * Draw the result and pass it to enabled outputs. Nothing is drawn into the
+ * pushed frame.
+ * 
+ * @param result
+ */
+void VictimTracker::write_outputs(const TrackingResult& result) {
+
+    TraceScope trace("outputs");
+
+    bool annotated_recording = (sinks & SINK_RECORDING) && track_recorder == NULL;
+
+    if (annotated_recording || (sinks & SINK_USER_INTERFACE)) {
+
+        // We are in back projection mode
+        if (back_projection_mode && !back_projection.empty()) {
+            Mat displayed_projection = back_projection;
+            if (back_projection.size() != original_frame.size()) {
+                resize(back_projection, displayed_projection, original_frame.size(), 0, 0, INTER_NEAREST);
+            }
+            cvtColor(displayed_projection, output_frame, COLOR_GRAY2BGR);
+        } else {
+            original_frame.copyTo(output_frame);
+        }
+
+        // Draw bounding ellipse and cross hairs
+        if (object_selected) {
+            overlay->draw_track(output_frame, get_tracking_box());
+        }
+
+        // Get status as a string message
+        overlay->print_status(output_frame, status);
+
+        // Show the selection
+        show_selection();
+
+        // Show the histogram
+        //user_interface->show_histogram(histogram_image);
+
+    }
 
     // Main Window
     ////////////////////////////////////////////////////////////////////////
 
 #ifdef USER_INTERFACE
-    // Get status as a string message
-    user_interface->print_status(original_frame, status);
+    if (user_interface != NULL) {
 
-    Mat output;
-    original_frame.copyTo(output);
+        // Show output frame in the main window
+        user_interface->show_main(output_frame);
 
-    // Show output frame in the main window
-    user_interface->show_main(output);
+    }
 #endif
 
     ////////////////////////////////////////////////////////////////////////
     // Video output
     ////////////////////////////////////////////////////////////////////////
 
-    // Write the frame to the output video
-    video_writer << original_frame;
-    //video_writer << threshold_color;
+    if (annotated_recording) {
+
+        // Write the frame to the output video
+        video_writer << output_frame;
+        //video_writer << threshold_color;
+
+    } else if (track_recorder != NULL && !paused) {
+
+        // Write only the result, overlays are rendered offline. The first
+        // frame anchors the track in a copied stream.
+        track_recorder->set_anchor(source_frame);
+        track_recorder->write(result, status);
+
+    }
 
     ////////////////////////////////////////////////////////////////////////
     // Log output
@@ -499,10 +1351,24 @@ int VictimTracker::logic() {
     // Debugging
     //cout << "Throttle: " << current_commands->get_throttle() << " Rudder: " << current_commands->get_rudder() << endl;
 
-    // Log the data
-    create_log_entry(logger);
+    if (logger != NULL) {
 
-    return 0;
+        // Log the data
+        create_log_entry(logger.get());
+
+    }
+
+}
+
+/**
+ * Get channel of published results. Readers on any thread get consistent
+ * snapshots and history without locking.
+ * 
+ * @return 
+ */
+const ResultChannel& VictimTracker::getResultChannel() {
+
+    return * result_channel;
 
 }
 
@@ -526,4 +1392,50 @@ Size2f VictimTracker::getSize() {
 
     return victim_size;
 
-}
\ No newline at end of file
+}
+
+/**
+ * Get confidence of the current track.
+ * 
+ * @return confidence in range 0-1
+ */
+double VictimTracker::getConfidence() {
+
+    return tracking_result.confidence;
+
+}
+
+/**
+ * Get bearing and angular size of the victim.
+ * 
+ * @return bearing of the last tracked frame, invalid without calibration
+ */
+TargetBearing VictimTracker::getBearing() {
+
+    return victim_bearing;
+
+}
+
+/**
+ * Get outage counters of the video source. Pushed frames have no source,
+ * so the counters stay empty.
+ * 
+ * @return 
+ */
+StreamStatistics VictimTracker::getStreamStatistics() {
+
+    return stream_supervisor != NULL ? stream_supervisor->get_statistics() : StreamStatistics();
+
+}
+
+/**
+ * Get global image shift of the last frame caused by pitch and roll of the
+ * boat, in processing pixels. Zero unless ego-motion compensation is on.
+ * 
+ * @return 
+ */
+Point2f VictimTracker::getCameraMotion() {
+
+    return camera_motion;
+
+}
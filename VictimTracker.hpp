@@ -8,8 +8,8 @@
 #ifndef VICTIMTRACKER_HPP
 #define VICTIMTRACKER_HPP
 
-// Comment the following line if you do not want user interface
-#define USER_INTERFACE
+// User interface is built if USER_INTERFACE is defined, which CMake does
+// unless EMILY_USER_INTERFACE is OFF
 
 ////////////////////////////////////////////////////////////////////////////////
 // Includes
@@ -19,11 +19,32 @@
 #include <time.h>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include "opencv2/opencv.hpp"
 #include "Settings.hpp"
 #include "OutputVideo.hpp"
 #include "Logger.hpp"
 #include "UserInterface.hpp"
+#include "HueBackProjector.hpp"
+#include "FramePipeline.hpp"
+#include "IntegralCamShift.hpp"
+#include "ParticleTracker.hpp"
+#include "FrameChangeDetector.hpp"
+#include "HorizonDetector.hpp"
+#include "EgoMotionEstimator.hpp"
+#include "ThreadPlacement.hpp"
+#include "BlobDetector.hpp"
+#include "CameraModel.hpp"
+#include "SharedFrameRing.hpp"
+#include "StreamSupervisor.hpp"
+#include "TrackingResult.hpp"
+#include "TrackRecorder.hpp"
+#include "Overlay.hpp"
+#include "ColorModel.hpp"
+#include "ResolutionController.hpp"
+#include "ResultChannel.hpp"
+#include "Tracer.hpp"
+#include "LatencyProbe.hpp"
 #include <sys/socket.h>
 #include <netdb.h>
 #include <stdlib.h>
@@ -48,22 +69,76 @@ extern bool select_object;
 extern int object_selected;
 extern Rect selection;
 
+////////////////////////////////////////////////////////////////////////////////
+// Embedding
+////////////////////////////////////////////////////////////////////////////////
+
+// Optional outputs of the tracker, combined as flags
+enum TrackerSink {
+    SINK_NONE = 0,
+    SINK_RECORDING = 1,
+    SINK_LOG = 2,
+    SINK_USER_INTERFACE = 4,
+    SINK_ALL = SINK_RECORDING | SINK_LOG | SINK_USER_INTERFACE
+};
+
+// Layout of raw frames pushed by the host
+enum PixelFormat {
+    PIXEL_FORMAT_BGR,
+    PIXEL_FORMAT_RGB,
+    PIXEL_FORMAT_BGRA,
+    PIXEL_FORMAT_RGBA,
+    PIXEL_FORMAT_NV12,
+    PIXEL_FORMAT_I420
+};
+
 class VictimTracker {
 public:
     
+    // Read frames from the video source in Settings and use all outputs
     VictimTracker();
-    VictimTracker(const VictimTracker& orig);
+
+    // Track frames pushed by the host
+    VictimTracker(Size, double = 0, int = SINK_NONE);
+
+    VictimTracker(const VictimTracker& orig) = delete;
+
+    VictimTracker& operator=(const VictimTracker& orig) = delete;
     virtual ~VictimTracker();
 
     // Main logic that is to be called on every iteration of the main loop
     int logic();
 
-    // Get center of the victims
+    // Track the victim in a frame owned by the caller
+    TrackingResult push(const Mat&);
+
+    // Track the victim in a raw frame owned by the caller
+    TrackingResult push(const uchar*, int, int, size_t, PixelFormat);
+
+    // Track the victim in a YUV frame with separate planes owned by the caller
+    TrackingResult push(const uchar * const *, const size_t *, int, int, PixelFormat);
+
+    // Results for readers on other threads
+    const ResultChannel& getResultChannel();
+
+    // Get center of the victims, only from the thread calling logic or push
     Point getCenter();
 
-    // Get size of the victims
+    // Get size of the victims, only from the thread calling logic or push
     Size2f getSize();
 
+    // Get confidence of the current track
+    double getConfidence();
+
+    // Get bearing and angular size of the victim
+    TargetBearing getBearing();
+
+    // Get outage counters of the video source
+    StreamStatistics getStreamStatistics();
+
+    // Get global image shift of the last frame caused by the boat motion
+    Point2f getCameraMotion();
+
 private:
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -76,7 +151,11 @@ private:
     // Video Capture
     ////////////////////////////////////////////////////////////////////////////////
 
-    VideoCapture video_capture = VideoCapture(settings->video_capture_source);
+    // Video source, reopened when the stream drops
+    unique_ptr<StreamSupervisor> stream_supervisor;
+
+    // Frames published by the frame server
+    unique_ptr<SharedFrameRing> frame_ring;
 
     ////////////////////////////////////////////////////////////////////////////////
     // Global variables
@@ -91,9 +170,40 @@ private:
     // Indicates that resizing is necessary
     bool resize_video = false;
 
+    // Ratio of input to processing resolution
+    double input_scale = 1;
+
+    // Size of frames read or pushed
+    Size input_frame_size;
+
+    // Enabled outputs
+    int sinks = SINK_NONE;
+
+    // Last frame read from the video source
+    Mat input_frame;
+
+    // Planes of a pushed YUV frame packed for conversion
+    Mat yuv_frame;
+
     // Original frame
     Mat original_frame;
 
+    // Frame in full resolution, the input or the undistorted original frame
+    Mat source_frame;
+
+    // Frame at the tracking resolution
+    Mat tracking_frame;
+
+    // Ratio of tracking to processing resolution. Search window, back
+    // projection and CamShift result are in tracking resolution.
+    double tracking_scale = 1;
+
+    // Annotated frame for display and recording
+    Mat output_frame;
+
+    // Number of pushed frames
+    int64_t frame_number = 0;
+
     // EMILY location
     Point victim_location;
 
@@ -104,7 +214,7 @@ private:
     Point * emily_location_history = new Point[settings->EMILY_LOCATION_HISTORY_SIZE];
 
     // Timer to estimate EMILY heading
-    int emily_location_history_pointer;
+    int emily_location_history_pointer = 0;
 
     // Status of the algorithm
     int status = 0;
@@ -114,20 +224,27 @@ private:
 
     VideoWriter video_writer;
 
-    Logger * logger;
+    // Track sidecar when frames are not recorded with the overlay
+    unique_ptr<TrackRecorder> track_recorder;
+
+    // Draws the result into the output frame
+    unique_ptr<Overlay> overlay;
+
+    unique_ptr<Logger> logger;
 
 #ifdef USER_INTERFACE
-    UserInterface * user_interface;
+    unique_ptr<UserInterface> user_interface;
 #endif
 
-    // Frame with edits for blob detection
-    Mat blured_frame;
-
     // Rectangle representing object of interest
     Rect object_of_interest;
 
     // Size of histogram of object of interest
+#ifdef PROFILE_HISTOGRAM_SIZE
+    int histogram_size = PROFILE_HISTOGRAM_SIZE;
+#else
     int histogram_size = 16;
+#endif
 
     // Histogram ranges
     float histogram_ranges[2];
@@ -148,6 +265,68 @@ private:
     // Back projection of histogram
     Mat back_projection;
 
+    // Back projection kernel for the current histogram
+    HueBackProjector back_projector;
+
+    // Histogram adapted to the current appearance of the victim
+    unique_ptr<ColorModel> color_model;
+
+    // Blur, HSV, threshold and back projection pipeline
+    unique_ptr<FramePipeline> frame_pipeline;
+
+    // Pipeline scaling is printed only once
+    bool pipeline_scaling_reported = false;
+
+    // Frames processed only around the victim because of a fine tracking
+    // resolution since the whole frame was processed
+    int region_only_frames = 0;
+
+    // CamShift on integral images of back projection
+    unique_ptr<IntegralCamShift> integral_camshift;
+
+    // Result of the last CamShift
+    CamShiftResult tracking_result;
+
+    // Particle filter seeding CamShift
+    unique_ptr<ParticleTracker> particle_tracker;
+
+    // Result of the last particle filter step
+    ParticleResult particle_result;
+
+    // Chooses the tracking resolution from the size of the victim
+    unique_ptr<ResolutionController> resolution_controller;
+
+    // Detects frames which do not need to be processed
+    unique_ptr<FrameChangeDetector> change_detector;
+
+    // Finds the rows of the frame above the water
+    unique_ptr<HorizonDetector> horizon_detector;
+
+    // Estimates the image shift caused by pitch and roll
+    unique_ptr<EgoMotionEstimator> ego_motion_estimator;
+
+    // Image shift of the current and of the previous frame in processing pixels
+    Point2f camera_motion;
+    Point2f previous_camera_motion;
+
+    // Finds the victim again when the track is lost
+    unique_ptr<BlobDetector> blob_detector;
+
+    // Calibration scaled to processing resolution
+    unique_ptr<CameraModel> camera_model;
+
+    // Bearing of the victim for the last tracking result
+    TargetBearing victim_bearing;
+
+    // Published results for concurrent readers
+    unique_ptr<ResultChannel> result_channel;
+
+    // Chrome trace written on exit or on SIGUSR1
+    string trace_file_name;
+
+    // Age of stamped frames at the published result
+    unique_ptr<LatencyProbe> latency_probe;
+
     // Paused mode
     bool paused = false;
 
@@ -159,7 +338,13 @@ private:
 
     void get_input_video_size();
 
-    void equalize(Mat&);
+    void set_input_video_size(Size);
+
+    void initialize(double, int);
+
+    void write_outputs(const TrackingResult&);
+
+    void read_frame(Mat&);
 
     void create_histogram(Rect&, int&, const float*&, Mat&, Mat&, Mat&, Mat&);
 
@@ -167,8 +352,28 @@ private:
 
     void update_history();
 
+    Point get_victim_motion();
+
     void show_selection();
 
+    void select_tracking_level(bool);
+
+    void set_tracking_scale(double);
+
+    void compensate_camera_motion();
+
+    RotatedRect get_tracking_box();
+
+    void track_victim(FrameChange);
+
+    void run_camshift();
+
+    bool is_track_lost();
+
+    void adapt_color_model();
+
+    void apply_color_model();
+
 };
 
 #endif /* VICTIMTRACKER_HPP */
@@ -7,10 +7,27 @@
  * This is an example on how to use VictimTracker class.
  * VictimTracker class is used to track a victim wearing a red or yellow life jacket in the input video feed.
  *
+ * A host which already has frames in memory creates the tracker with the frame size instead and pushes frames:
+ *
+ *     VictimTracker tracker(Size(1280, 720), 30, SINK_NONE);
+ *     TrackingResult result = tracker.push(data, 1280, 720, stride, PIXEL_FORMAT_BGR);
+ *
+ * YUV frames from a decoder are pushed plane by plane:
+ *
+ *     const uchar * planes[] = {y, uv};
+ *     size_t strides[] = {y_stride, uv_stride};
+ *     TrackingResult result = tracker.push(planes, strides, 1280, 720, PIXEL_FORMAT_NV12);
+ *
  */
 
 #include "opencv2/opencv.hpp"
 #include "VictimTracker.hpp"
+#include "FrameServer.hpp"
+#include "OverlayRenderer.hpp"
+#include "SoakRunner.hpp"
+#include "ChunkedProcessor.hpp"
+#include "LatencyProbe.hpp"
+#include "SceneGenerator.hpp"
 
 using namespace cv;
 
@@ -28,8 +45,106 @@ Rect selection;
 
 int main(int argc, char** argv) {
 
+    // Run as frame server that decodes the input once for all consumer processes
+    // The tracker consumes served frames if use_frame_server is set in Settings.hpp
+    if (argc > 1 && string(argv[1]) == "--serve") {
+
+        Settings settings;
+        FrameServer frame_server(settings);
+
+        return frame_server.run();
+
+    }
+
+    // Render a recorded track onto its source video
+    // Usage: --render <track file> [<source video>] [<output name>]
+    if (argc > 2 && string(argv[1]) == "--render") {
+
+        Settings settings;
+        OverlayRenderer overlay_renderer(settings);
+
+        return overlay_renderer.run(argv[2], argc > 3 ? argv[3] : "", argc > 4 ? argv[4] : "");
+
+    }
+
+    // Replay the input for hours of mission time and check that memory stays flat
+    // Usage: --soak <hours> [<leg minutes> [<input video>]]
+    if (argc > 2 && string(argv[1]) == "--soak") {
+
+        Settings settings;
+
+        if (argc > 3) {
+            settings.soak_leg_minutes = atof(argv[3]);
+        }
+
+        if (argc > 4) {
+            settings.video_capture_source = argv[4];
+        }
+
+        SoakRunner soak_runner(settings);
+
+        return soak_runner.run(atof(argv[2]));
+
+    }
+
+    // Track a recorded video file on all cores and write one track file
+    // Usage: --chunks <video file> [<number of workers>]
+    if (argc > 2 && string(argv[1]) == "--chunks") {
+
+        Settings settings;
+        ChunkedProcessor chunked_processor(settings);
+
+        return chunked_processor.run(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+
+    }
+
+    // Generate stamped frames through a loopback stream, track them and
+    // report glass-to-output latency
+    // Usage: --latency <seconds> [<file or stream URL>]
+    if (argc > 2 && string(argv[1]) == "--latency") {
+
+        Settings settings;
+        LatencyProbe latency_probe(settings);
+
+        return latency_probe.run(argc > 3 ? argv[3] : "udp://127.0.0.1:5600", atof(argv[2]));
+
+    }
+
+    // Only generate stamped frames, for a tracker with latency_probe set
+    // Usage: --latency-source <file or stream URL> [<seconds>]
+    if (argc > 2 && string(argv[1]) == "--latency-source") {
+
+        Settings settings;
+        LatencyProbe latency_probe(settings);
+
+        return latency_probe.generate(argv[2], argc > 3 ? atof(argv[3]) : 60);
+
+    }
+
+    // Render a synthetic sea scene with ground truth
+    // Usage: --generate <output name> [<width> <height> [<fps> [<seconds> [<number of victims>]]]]
+    if (argc > 2 && string(argv[1]) == "--generate") {
+
+        Settings settings;
+        SceneGenerator scene_generator(settings);
+
+        Size size(argc > 4 ? atoi(argv[3]) : 1920, argc > 4 ? atoi(argv[4]) : 1080);
+        double fps = argc > 5 ? atof(argv[5]) : 30;
+        double seconds = argc > 6 ? atof(argv[6]) : 60;
+        int targets = argc > 7 ? atoi(argv[7]) : 1;
+
+        // A width without a height, or values which are not positive numbers
+        if (argc == 4 || argc > 8 || size.width <= 0 || size.height <= 0 || fps <= 0 || seconds <= 0 || targets < 0) {
+            cout << "Usage: --generate <output name> [<width> <height> [<fps> [<seconds> [<number of victims>]]]]" << endl;
+            return -1;
+        }
+
+        return scene_generator.run(argv[2], size, fps, seconds, targets);
+
+    }
+
     // Initialize VictimTracker class
-    // User interface can be disabled by going in VictimTracker.hpp and commenting "#define USER_INTERFACE" line
+    // User interface can be disabled by configuring with cmake -DEMILY_USER_INTERFACE=OFF
     VictimTracker * victimTracker = new VictimTracker();
 
     // This is the main loop
@@ -0,0 +1,41 @@
+/*
+ * File:   Check.hpp
+ * Author: Jan Dufek
+ */
+
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <iostream>
+
+// Number of failed checks of the test
+static int check_failures = 0;
+
+/**
+ * Record a failed condition with its location and keep running, so that
+ * one run reports every mismatch.
+ */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cout << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            check_failures++; \
+        } \
+    } while (0)
+
+/**
+ * Exit status of the test.
+ *
+ * @return 0 if all checks passed
+ */
+static inline int check_result() {
+
+    if (check_failures > 0) {
+        std::cout << check_failures << " checks failed" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+#endif /* CHECK_HPP */
@@ -0,0 +1,96 @@
+/*
+ * File:   test_fixed_point.cpp
+ * Author: Jan Dufek
+ *
+ * Integer math of the fixed point tracking path against the C library.
+ */
+
+#include "Check.hpp"
+#include "../FixedPoint.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdint.h>
+
+// Q16 scale of angles, sines and cosines
+static const double ONE = 1 << FixedPoint::ANGLE_BITS;
+
+/**
+ * Largest atan2 error over vectors of one length around the circle.
+ *
+ * @param length
+ * @return error in radians
+ */
+static double atan2_error(double length) {
+
+    double largest = 0;
+
+    for (int i = 0; i < 36000; i++) {
+
+        double angle = -M_PI + 2 * M_PI * i / 36000;
+        int64_t x = llround(cos(angle) * length);
+        int64_t y = llround(sin(angle) * length);
+
+        if (x == 0 && y == 0) {
+            continue;
+        }
+
+        double error = fabs(FixedPoint::atan2(y, x) / ONE - atan2((double) y, (double) x));
+
+        // Both ends of the range are the same angle
+        error = std::min(error, 2 * M_PI - error);
+
+        largest = std::max(largest, error);
+
+    }
+
+    return largest;
+}
+
+int main() {
+
+    // Pi constant
+    CHECK(fabs(FixedPoint::PI / ONE - M_PI) < 1. / ONE);
+
+    // Square root rounded down
+    const uint64_t values[] = {0, 1, 2, 3, 4, 15, 16, 17, 1000000, 999999, ((uint64_t) 1 << 62) + 5, UINT64_MAX};
+    for (size_t i = 0; i < sizeof (values) / sizeof (values[0]); i++) {
+        uint64_t root = FixedPoint::sqrt(values[i]);
+        CHECK(root <= UINT32_MAX);
+        CHECK(root * root <= values[i]);
+        CHECK(root == UINT32_MAX || (root + 1) * (root + 1) > values[i]);
+    }
+
+    // Division rounded to nearest, halves away from zero
+    CHECK(FixedPoint::divide_round(5, 2) == 3);
+    CHECK(FixedPoint::divide_round(-5, 2) == -3);
+    CHECK(FixedPoint::divide_round(4, 3) == 1);
+    CHECK(FixedPoint::divide_round(-4, 3) == -1);
+    CHECK(FixedPoint::divide_round(7, 3) == 2);
+    CHECK(FixedPoint::divide_round(0, 7) == 0);
+
+    // Angle of vectors from a few pixels to the size of raw image moments
+    const double lengths[] = {16, 256, 65536, 1e9, 1e15};
+    for (size_t i = 0; i < sizeof (lengths) / sizeof (lengths[0]); i++) {
+        CHECK(atan2_error(lengths[i]) < 6e-5);
+    }
+
+    // Axes and the zero vector
+    CHECK(FixedPoint::atan2(0, 0) == 0);
+    CHECK(abs(FixedPoint::atan2(0, 1000)) <= 4);
+    CHECK(abs(FixedPoint::atan2(1000, 0) - FixedPoint::PI / 2) <= 4);
+    CHECK(abs(FixedPoint::atan2(-1000, 0) + FixedPoint::PI / 2) <= 4);
+    CHECK(abs(abs(FixedPoint::atan2(0, -1000)) - FixedPoint::PI) <= 4);
+
+    // Sine and cosine over the whole range
+    double largest = 0;
+    for (int32_t angle = -FixedPoint::PI; angle <= FixedPoint::PI; angle++) {
+        int32_t sine, cosine;
+        FixedPoint::sin_cos(angle, sine, cosine);
+        largest = std::max(largest, fabs(sine / ONE - sin(angle / ONE)));
+        largest = std::max(largest, fabs(cosine / ONE - cos(angle / ONE)));
+    }
+    CHECK(largest < 2e-4);
+
+    return check_result();
+}
@@ -0,0 +1,107 @@
+/*
+ * File:   test_hue_back_projector.cpp
+ * Author: Jan Dufek
+ *
+ * Specialized back projection kernels must give the same output as
+ * calcBackProject followed by the saturation value mask.
+ */
+
+#include "Check.hpp"
+#include "../HueBackProjector.hpp"
+
+/**
+ * Back project with OpenCV the way the generic path does.
+ *
+ * @param hue
+ * @param mask
+ * @param histogram
+ * @param back_projection
+ */
+static void reference_project(const Mat& hue, const Mat& mask, const Mat& histogram, Mat& back_projection) {
+
+    float hue_range[] = {0, 180};
+    const float * ranges = hue_range;
+
+    calcBackProject(&hue, 1, 0, histogram, back_projection, &ranges);
+    back_projection &= mask;
+}
+
+/**
+ * Compare the projector with the reference on one image.
+ *
+ * @param projector
+ * @param histogram
+ * @param hue
+ * @param mask
+ */
+static void compare(const HueBackProjector& projector, const Mat& histogram, const Mat& hue, const Mat& mask) {
+
+    Mat expected, actual;
+    reference_project(hue, mask, histogram, expected);
+    projector.project(hue, mask, actual);
+
+    CHECK(actual.size() == expected.size());
+    CHECK(actual.type() == expected.type());
+    CHECK(countNonZero(actual != expected) == 0);
+}
+
+int main() {
+
+    RNG rng(20170301);
+
+    const int sizes[] = {8, 12, 16, 32, 64, 180, 24};
+    const float hue_range[] = {0, 180};
+
+    // Hues past 179 do not occur in HSV but must not read past the histogram
+    Mat hue(97, 131, CV_8UC1);
+    rng.fill(hue, RNG::UNIFORM, 0, 256);
+
+    Mat mask(hue.size(), CV_8UC1);
+    rng.fill(mask, RNG::UNIFORM, 0, 2);
+    mask *= 255;
+
+    // Every hue at least once
+    for (int i = 0; i < 256; i++) {
+        hue.at<uchar>(i / hue.cols, i % hue.cols) = (uchar) i;
+        mask.at<uchar>(i / hue.cols, i % hue.cols) = 255;
+    }
+
+    // Rows with padding take the row by row path
+    Rect roi(3, 5, 101, 77);
+
+    int specialized = 0;
+
+    for (size_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++) {
+
+        Mat histogram(sizes[i], 1, CV_32FC1);
+        rng.fill(histogram, RNG::UNIFORM, 0, 300);
+
+        // Exact bin values and values saturating to 255
+        histogram.at<float>(0) = 0;
+        histogram.at<float>(sizes[i] - 1) = 255.5f;
+
+        HueBackProjector projector;
+        projector.set_histogram(histogram, sizes[i], hue_range);
+
+        if (projector.is_specialized()) {
+            specialized++;
+        }
+
+        compare(projector, histogram, hue, mask);
+        compare(projector, histogram, hue(roi), mask(roi));
+
+    }
+
+    // Sizes without a kernel fall back to calcBackProject
+    CHECK(specialized > 0);
+
+    // Partial hue range is never specialized
+    const float partial_range[] = {10, 170};
+    Mat histogram(16, 1, CV_32FC1, Scalar(100));
+    HueBackProjector projector;
+    projector.set_histogram(histogram, 16, partial_range);
+    CHECK(!projector.is_specialized());
+    CHECK(projector.get_lut() == 0);
+
+    return check_result();
+}
@@ -0,0 +1,113 @@
+/*
+ * File:   test_integral_cam_shift.cpp
+ * Author: Jan Dufek
+ *
+ * CamShift on integral images must follow cv::CamShift on synthetic
+ * elongated blobs, in floating point and in integer arithmetic.
+ */
+
+#include "Check.hpp"
+#include "../IntegralCamShift.hpp"
+
+/**
+ * Difference of two box angles in degrees, taking the 180 degree period.
+ *
+ * @param a
+ * @param b
+ * @return
+ */
+static double angle_difference(double a, double b) {
+
+    double difference = fmod(fabs(a - b), 180.);
+
+    return min(difference, 180. - difference);
+}
+
+/**
+ * Back projection with a blurred ellipse over weak noise.
+ *
+ * @param rng
+ * @param center
+ * @param axes half axes of the ellipse
+ * @param angle
+ * @return
+ */
+static Mat make_blob(RNG& rng, Point center, Size axes, double angle) {
+
+    Mat back_projection(240, 320, CV_8UC1);
+    rng.fill(back_projection, RNG::UNIFORM, 0, 8);
+
+    Mat blob = Mat::zeros(back_projection.size(), CV_8UC1);
+    ellipse(blob, center, axes, angle, 0, 360, Scalar(220), FILLED);
+    GaussianBlur(blob, blob, Size(9, 9), 0);
+
+    return max(back_projection, blob);
+}
+
+/**
+ * Compare one IntegralCamShift result with cv::CamShift.
+ *
+ * @param result
+ * @param expected_box
+ * @param expected_window
+ * @param window_tolerance allowed shift of window edges in pixels
+ */
+static void compare(const CamShiftResult& result, const RotatedRect& expected_box, const Rect& expected_window, int window_tolerance) {
+
+    CHECK(abs(result.window.x - expected_window.x) <= window_tolerance);
+    CHECK(abs(result.window.y - expected_window.y) <= window_tolerance);
+    CHECK(abs(result.window.width - expected_window.width) <= 2 * window_tolerance);
+    CHECK(abs(result.window.height - expected_window.height) <= 2 * window_tolerance);
+
+    CHECK(fabs(result.box.center.x - expected_box.center.x) <= window_tolerance);
+    CHECK(fabs(result.box.center.y - expected_box.center.y) <= window_tolerance);
+    CHECK(fabs(result.box.size.width - expected_box.size.width) <= 0.02 * expected_box.size.width + 0.5);
+    CHECK(fabs(result.box.size.height - expected_box.size.height) <= 0.02 * expected_box.size.height + 0.5);
+    CHECK(angle_difference(result.box.angle, expected_box.angle) <= 1.);
+}
+
+int main() {
+
+    RNG rng(20170301);
+
+    TermCriteria criteria(TermCriteria::EPS | TermCriteria::COUNT, 10, 1);
+
+    const double angles[] = {0, 30, 75, 120, 160};
+
+    for (size_t i = 0; i < sizeof (angles) / sizeof (angles[0]); i++) {
+
+        Point center(100 + 25 * (int) i, 90 + 10 * (int) i);
+        Mat back_projection = make_blob(rng, center, Size(40, 14), angles[i]);
+
+        // Start off the blob so that mean shift has to move
+        Rect start(center.x - 30, center.y - 5, 40, 30);
+
+        Rect expected_window = start;
+        RotatedRect expected_box = CamShift(back_projection, expected_window, criteria);
+
+        IntegralCamShift cam_shift;
+        cam_shift.set_image(back_projection, Rect(0, 0, back_projection.cols, back_projection.rows));
+
+        cam_shift.set_integer_arithmetic(false);
+        compare(cam_shift.track(start, criteria), expected_box, expected_window, 1);
+
+        // Rounding of mean shift steps and box size may move the window by a pixel more
+        cam_shift.set_integer_arithmetic(true);
+        compare(cam_shift.track(start, criteria), expected_box, expected_window, 2);
+
+        // Window masses are exact sums of the back projection
+        Rect window(center.x - 17, center.y - 9, 33, 21);
+        CHECK(cam_shift.mass(window) == (int64) sum(back_projection(window))[0]);
+
+    }
+
+    // Empty back projection gives an empty box
+    Mat empty = Mat::zeros(120, 160, CV_8UC1);
+    IntegralCamShift cam_shift;
+    cam_shift.set_image(empty, Rect(0, 0, empty.cols, empty.rows));
+    CamShiftResult result = cam_shift.track(Rect(40, 40, 20, 20), criteria);
+    CHECK(result.box.size.area() == 0);
+    CHECK(result.confidence == 0);
+
+    return check_result();
+}
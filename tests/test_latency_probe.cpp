@@ -0,0 +1,99 @@
+/*
+ * File:   test_latency_probe.cpp
+ * Author: Jan Dufek
+ *
+ * Latency stamps read back after the resizing the tracker applies on the
+ * way, and frames without a stamp are rejected.
+ */
+
+#include "Check.hpp"
+#include "../LatencyProbe.hpp"
+
+// Globals normally defined in main.cpp
+bool select_object = false;
+int object_selected = 0;
+Rect selection;
+
+// Size the probe generates
+static const Size GENERATED_SIZE(1280, 720);
+
+/**
+ * Check that a frame reads back the stamped values.
+ *
+ * @param frame
+ * @param counter
+ * @param time_us
+ * @return
+ */
+static bool reads_back(const Mat& frame, uint32_t counter, int64_t time_us) {
+
+    uint32_t read_counter = 0;
+    int64_t read_time_us = 0;
+
+    if (!LatencyProbe::read_stamp(frame, read_counter, read_time_us)) {
+        return false;
+    }
+
+    return read_counter == counter && read_time_us == time_us;
+}
+
+int main() {
+
+    RNG rng(20170301);
+
+    // Scene colours around the stamp
+    Mat frame(GENERATED_SIZE, CV_8UC3);
+    rng.fill(frame, RNG::UNIFORM, Scalar(60, 40, 0), Scalar(160, 120, 60));
+
+    const uint32_t counter = 0xDEADBEEF;
+    const int64_t time_us = 0x123456789ABCLL;
+
+    LatencyProbe::stamp(frame, counter, time_us);
+    CHECK(reads_back(frame, counter, time_us));
+
+    // Processing resolutions with the interpolations used on the way
+    const Size sizes[] = {Size(640, 360), Size(320, 180), Size(480, 360)};
+    const int interpolations[] = {INTER_AREA, INTER_LINEAR, INTER_LANCZOS4};
+
+    for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes[0]); s++) {
+        for (size_t i = 0; i < sizeof (interpolations) / sizeof (interpolations[0]); i++) {
+            Mat resized;
+            resize(frame, resized, sizes[s], 0, 0, interpolations[i]);
+            CHECK(reads_back(resized, counter, time_us));
+        }
+    }
+
+    // Smallest readable frame, two pixels per cell
+    Mat smallest;
+    resize(frame, smallest, Size(160, 90), 0, 0, INTER_AREA);
+    CHECK(reads_back(smallest, counter, time_us));
+
+    // Cells below two pixels are refused
+    Mat too_small;
+    resize(frame, too_small, Size(158, 90), 0, 0, INTER_AREA);
+    uint32_t read_counter;
+    int64_t read_time_us;
+    CHECK(!LatencyProbe::read_stamp(too_small, read_counter, read_time_us));
+
+    // Stamping at another size
+    Mat other(Size(1920, 1080), CV_8UC3, Scalar(110, 80, 30));
+    LatencyProbe::stamp(other, 7, 1);
+    CHECK(reads_back(other, 7, 1));
+    resize(other, other, Size(400, 225), 0, 0, INTER_AREA);
+    CHECK(reads_back(other, 7, 1));
+
+    // Frames without a stamp
+    Mat black(GENERATED_SIZE, CV_8UC3, Scalar::all(0));
+    Mat white(GENERATED_SIZE, CV_8UC3, Scalar::all(255));
+    CHECK(!LatencyProbe::read_stamp(black, read_counter, read_time_us));
+    CHECK(!LatencyProbe::read_stamp(white, read_counter, read_time_us));
+
+    // A flipped bit fails the checksum
+    Mat damaged = frame.clone();
+    Rect first_cell(GENERATED_SIZE.width / 80, GENERATED_SIZE.height / 45, GENERATED_SIZE.width / 80, GENERATED_SIZE.height / 45);
+    Scalar level = mean(damaged(first_cell));
+    rectangle(damaged, first_cell, level[0] > 128 ? Scalar::all(0) : Scalar::all(255), -1);
+    CHECK(!LatencyProbe::read_stamp(damaged, read_counter, read_time_us));
+
+    return check_result();
+}
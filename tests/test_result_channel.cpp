@@ -0,0 +1,206 @@
+/*
+ * File:   test_result_channel.cpp
+ * Author: Jan Dufek
+ *
+ * Results published by the vision thread reach readers in order, history
+ * and velocity follow the ring, and concurrent readers never see a torn
+ * snapshot.
+ */
+
+#include "Check.hpp"
+#include "../ResultChannel.hpp"
+#include <thread>
+
+// Slots of the channel
+static const int HISTORY_SIZE = 8;
+
+// Results published by the writer thread
+static const int STRESS_RESULTS = 200000;
+
+// Readers running against the writer thread
+static const int READERS = 2;
+
+// Nanoseconds between results
+static const int64_t FRAME_PERIOD = 100000000;
+
+/**
+ * Result whose every field follows from its frame number.
+ *
+ * @param frame_number
+ * @return
+ */
+static TrackingResult make_result(int64_t frame_number) {
+
+    TrackingResult result;
+    result.frame_number = frame_number;
+    result.timestamp = frame_number * FRAME_PERIOD;
+    result.valid = true;
+    result.center = Point2f((float) (frame_number % 1000), (float) (2 * (frame_number % 1000)));
+    result.size = Size2f((float) (frame_number % 100), (float) (frame_number % 7));
+    result.angle = (float) (frame_number % 180);
+    result.confidence = 0.5;
+
+    return result;
+}
+
+/**
+ * Check that a snapshot was copied from a single result.
+ *
+ * @param snapshot
+ * @return
+ */
+static bool is_consistent(const TrackSnapshot& snapshot) {
+
+    int64_t frame_number = snapshot.frame_number;
+
+    return snapshot.sequence == (uint64_t) frame_number + 1
+            && snapshot.timestamp == frame_number * FRAME_PERIOD
+            && snapshot.x == (float) (frame_number % 1000)
+            && snapshot.y == (float) (2 * (frame_number % 1000))
+            && snapshot.width == (float) (frame_number % 100)
+            && snapshot.height == (float) (frame_number % 7)
+            && snapshot.angle == (float) (frame_number % 180);
+}
+
+// Written by each reader thread, checked on the main thread after join
+static int torn_snapshots[READERS];
+static int out_of_order[READERS];
+
+/**
+ * Read the newest result and the history until the writer finishes.
+ *
+ * @param channel
+ * @param reader index of the reader
+ * @param done set by the main thread after the writer finished
+ */
+static void read_results(const ResultChannel * channel, int reader, const std::atomic<bool> * done) {
+
+    uint64_t last_sequence = 0;
+    TrackSnapshot history[HISTORY_SIZE];
+
+    while (!done->load(std::memory_order_acquire)) {
+
+        TrackSnapshot snapshot;
+
+        if (channel->latest(snapshot)) {
+
+            if (!is_consistent(snapshot)) {
+                torn_snapshots[reader]++;
+            }
+
+            if (snapshot.sequence < last_sequence) {
+                out_of_order[reader]++;
+            }
+
+            last_sequence = snapshot.sequence;
+
+        }
+
+        int count = channel->history(history, HISTORY_SIZE);
+
+        for (int i = 0; i < count; i++) {
+
+            if (!is_consistent(history[i])) {
+                torn_snapshots[reader]++;
+            }
+
+            if (i > 0 && history[i].sequence + 1 != history[i - 1].sequence) {
+                out_of_order[reader]++;
+            }
+
+        }
+
+    }
+}
+
+int main() {
+
+    // Nothing published yet
+    {
+        ResultChannel channel(HISTORY_SIZE);
+        TrackSnapshot snapshot;
+        TrackSnapshot history[HISTORY_SIZE];
+        Point2f speed;
+
+        CHECK(!channel.latest(snapshot));
+        CHECK(channel.history(history, HISTORY_SIZE) == 0);
+        CHECK(!channel.velocity(speed, FRAME_PERIOD * 10));
+    }
+
+    // Sequential publication
+    {
+        ResultChannel channel(HISTORY_SIZE);
+        TrackSnapshot snapshot;
+
+        for (int i = 0; i < 20; i++) {
+            channel.publish(make_result(i));
+        }
+
+        CHECK(channel.latest(snapshot));
+        CHECK(snapshot.sequence == 20);
+        CHECK(snapshot.frame_number == 19);
+        CHECK(is_consistent(snapshot));
+
+        // The slot about to be reused is left out of the history
+        TrackSnapshot history[2 * HISTORY_SIZE];
+        int count = channel.history(history, 2 * HISTORY_SIZE);
+        CHECK(count == HISTORY_SIZE - 1);
+        for (int i = 0; i < count; i++) {
+            CHECK(history[i].frame_number == 19 - i);
+            CHECK(is_consistent(history[i]));
+        }
+
+        CHECK(channel.history(history, 3) == 3);
+        CHECK(channel.history(history, 0) == 0);
+    }
+
+    // Velocity over valid results inside of the window
+    {
+        ResultChannel channel(HISTORY_SIZE);
+        Point2f speed;
+
+        for (int i = 0; i < 6; i++) {
+            TrackingResult result = make_result(i);
+            result.center = Point2f(10.f * i, -5.f * i);
+            result.valid = (i != 4);
+            channel.publish(result);
+        }
+
+        // 10 pixels and -5 pixels every 100 ms
+        CHECK(channel.velocity(speed, FRAME_PERIOD * 10));
+        CHECK(fabs(speed.x - 100) < 1e-3);
+        CHECK(fabs(speed.y + 50) < 1e-3);
+
+        // Window shorter than the gap to the previous valid result
+        CHECK(!channel.velocity(speed, FRAME_PERIOD));
+    }
+
+    // One writer against concurrent readers
+    {
+        ResultChannel channel(HISTORY_SIZE);
+        std::atomic<bool> done(false);
+
+        std::thread readers[READERS];
+        for (int r = 0; r < READERS; r++) {
+            readers[r] = std::thread(read_results, &channel, r, &done);
+        }
+
+        for (int i = 0; i < STRESS_RESULTS; i++) {
+            channel.publish(make_result(i));
+        }
+
+        done.store(true, std::memory_order_release);
+
+        for (int r = 0; r < READERS; r++) {
+            readers[r].join();
+            CHECK(torn_snapshots[r] == 0);
+            CHECK(out_of_order[r] == 0);
+        }
+
+        TrackSnapshot snapshot;
+        CHECK(channel.latest(snapshot));
+        CHECK(snapshot.frame_number == STRESS_RESULTS - 1);
+    }
+
+    return check_result();
+}
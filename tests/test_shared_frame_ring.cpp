@@ -0,0 +1,141 @@
+/*
+ * File:   test_shared_frame_ring.cpp
+ * Author: Jan Dufek
+ *
+ * Frames published by the server side of the ring reach an attached
+ * consumer, and frames overwritten while in use are reported invalid.
+ */
+
+#include "Check.hpp"
+#include "../SharedFrameRing.hpp"
+#include <thread>
+#include <unistd.h>
+
+// Ring geometry
+static const Size FRAME_SIZE(64, 48);
+static const int SLOT_COUNT = 3;
+
+// Frames published by the writer thread
+static const int STRESS_FRAMES = 2000;
+
+/**
+ * Frame with every byte set to the value.
+ *
+ * @param value
+ * @return
+ */
+static Mat uniform_frame(int value) {
+    return Mat(FRAME_SIZE, CV_8UC3, Scalar::all(value & 255));
+}
+
+/**
+ * Check that every byte of the frame has the same value.
+ *
+ * @param frame
+ * @return
+ */
+static bool is_uniform(const Mat& frame) {
+
+    double minimum, maximum;
+    minMaxLoc(frame.reshape(1), &minimum, &maximum);
+
+    return minimum == maximum;
+}
+
+/**
+ * Server writing frames directly into slots, as the decoder does.
+ *
+ * @param server
+ */
+static void write_frames(SharedFrameRing * server) {
+
+    for (int i = 1; i <= STRESS_FRAMES; i++) {
+        Mat slot = server->begin_write();
+        slot.setTo(Scalar::all(i & 255));
+        server->end_write(slot);
+    }
+}
+
+int main() {
+
+    string name = "/emily_test_ring_" + to_string(getpid());
+
+    SharedFrameRing server;
+    CHECK(server.create(name, FRAME_SIZE, CV_8UC3, SLOT_COUNT, 30));
+
+    SharedFrameRing consumer;
+    CHECK(!consumer.attach(name + "_missing"));
+    CHECK(consumer.attach(name));
+    CHECK(consumer.get_size() == FRAME_SIZE);
+    CHECK(consumer.get_type() == CV_8UC3);
+    CHECK(consumer.get_fps() == 30);
+
+    Mat frame;
+    uint64_t sequence;
+
+    // Nothing published yet
+    CHECK(!consumer.acquire(frame, sequence, 0));
+
+    // One frame arrives intact
+    server.publish(uniform_frame(1));
+    CHECK(consumer.acquire(frame, sequence, 100));
+    CHECK(norm(frame, uniform_frame(1), NORM_INF) == 0);
+    CHECK(consumer.is_valid(sequence));
+
+    // The same frame is not returned twice
+    CHECK(!consumer.acquire(frame, sequence, 10));
+
+    // Frames published in between are skipped
+    server.publish(uniform_frame(2));
+    server.publish(uniform_frame(3));
+    server.publish(uniform_frame(4));
+    CHECK(consumer.acquire(frame, sequence, 100));
+    CHECK(norm(frame, uniform_frame(4), NORM_INF) == 0);
+
+    // Frames of other sizes are scaled into the slot
+    server.publish(Mat(FRAME_SIZE * 2, CV_8UC3, Scalar::all(5)));
+    CHECK(consumer.acquire(frame, sequence, 100));
+    CHECK(frame.size() == FRAME_SIZE);
+    CHECK(norm(frame, uniform_frame(5), NORM_INF) == 0);
+
+    // A frame stays valid until the server laps the ring and reaches its slot
+    for (int i = 6; i < 6 + SLOT_COUNT - 1; i++) {
+        server.publish(uniform_frame(i));
+        CHECK(consumer.is_valid(sequence));
+    }
+    server.begin_write();
+    CHECK(!consumer.is_valid(sequence));
+
+    // A cancelled write keeps the old frame of the slot invalid and publishes nothing
+    server.cancel_write();
+    CHECK(!consumer.is_valid(sequence));
+    CHECK(consumer.acquire(frame, sequence, 100));
+    CHECK(norm(frame, uniform_frame(7), NORM_INF) == 0);
+    CHECK(!consumer.acquire(frame, sequence, 10));
+
+    // Under a concurrent writer every frame passing is_valid is untorn
+    std::thread writer(write_frames, &server);
+
+    int valid = 0;
+    Mat copy;
+
+    while (consumer.acquire(frame, sequence, 500)) {
+
+        frame.copyTo(copy);
+
+        if (consumer.is_valid(sequence)) {
+            CHECK(is_uniform(copy));
+            valid++;
+        }
+
+    }
+
+    writer.join();
+
+    CHECK(valid > 0);
+
+    server.close();
+    CHECK(!consumer.attach(name));
+
+    return check_result();
+}
@@ -0,0 +1,66 @@
+/*
+ * File:   test_thread_placement.cpp
+ * Author: Jan Dufek
+ *
+ * Core lists of the thread placement settings.
+ */
+
+#include "Check.hpp"
+#include "../ThreadPlacement.hpp"
+#include <sched.h>
+
+/**
+ * Parse a core list and compare it with the expected cores.
+ *
+ * @param text
+ * @param expected
+ * @return
+ */
+static bool parses_to(const string& text, const vector<int>& expected) {
+
+    vector<int> cores;
+
+    return ThreadPlacement::parse_cores(text, cores) && cores == expected;
+}
+
+/**
+ * Check that a core list is refused.
+ *
+ * @param text
+ * @return
+ */
+static bool is_refused(const string& text) {
+
+    vector<int> cores;
+
+    return !ThreadPlacement::parse_cores(text, cores);
+}
+
+int main() {
+
+    // Empty list leaves placement to the scheduler
+    CHECK(parses_to("", vector<int>()));
+    CHECK(parses_to(",", vector<int>()));
+
+    CHECK(parses_to("0", vector<int>{0}));
+    CHECK(parses_to("2-3", vector<int>{2, 3}));
+    CHECK(parses_to("0,2-3", vector<int>{0, 2, 3}));
+    CHECK(parses_to("1, 4-6", vector<int>{1, 4, 5, 6}));
+    CHECK(parses_to("5-5", vector<int>{5}));
+
+    // Malformed lists
+    CHECK(is_refused("a"));
+    CHECK(is_refused("-1"));
+    CHECK(is_refused("3-2"));
+    CHECK(is_refused("2-"));
+    CHECK(is_refused("2:3"));
+    CHECK(is_refused("2-3x"));
+    CHECK(is_refused("1 2"));
+
+    // Cores past the affinity mask, also as the end of a range
+    CHECK(is_refused(to_string(CPU_SETSIZE)));
+    CHECK(is_refused("0-" + to_string(CPU_SETSIZE)));
+    CHECK(parses_to(to_string(CPU_SETSIZE - 1), vector<int>{CPU_SETSIZE - 1}));
+
+    return check_result();
+}